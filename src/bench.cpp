@@ -0,0 +1,400 @@
+// Benchmarks of the dictionary and of the suggestions hot paths. Run
+// them with `make bench`.
+
+// Includes
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <new>
+#include <vector>
+#include <string>
+#include <stdlib.h>
+#include <string.h>
+
+// Local includes
+#include "data_structs_n_constants.h"
+#include "game_manager.cpp"
+#include "simulation.cpp"
+#include "suggestions.cpp"
+#include "trie_manager.cpp"
+
+using namespace std;
+
+// Every allocation of the program is counted
+atomic <long> allocations(0);
+
+// The replaced operators are a matching pair, but once they are
+// inlined GCC sees free() called on memory from new
+#if defined(__GNUC__) && !defined(__clang__) && __GNUC__ >= 11
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+
+void *
+operator new(size_t size)
+{
+    allocations++;
+    void *p = malloc(size ? size : 1);
+    if (p == nullptr) throw bad_alloc();
+    return p;
+}
+
+void
+operator delete(void *p) noexcept
+{
+    free(p);
+}
+
+#if defined(__GNUC__) && !defined(__clang__) && __GNUC__ >= 11
+#pragma GCC diagnostic pop
+#endif
+
+// Results of the timed calls are stored here, so that the compiler
+// can't drop the calls
+volatile long sink;
+
+string filename = "dictionary.txt";
+bool minimize_dictionary = false;
+// File keeping the corpus between runs, empty to play it every run
+string corpus_filename;
+
+// Runs of the slow benchmarks, as loading a dictionary
+#define LOAD_RUNS 3
+// Lookups timed together, as one is too fast for the clock
+#define LOOKUP_BATCH 1024
+// Games played for the corpus of every board size and hand
+#define CORPUS_GAMES 4
+// A board is saved in the corpus every this many turns
+#define CORPUS_INTERVAL 4
+// Runs of get_suggestions and get_cross_checks on every saved board
+#define BOARD_RUNS 3
+
+// Time and allocations of every call of a benchmark
+struct Samples {
+    vector <double> seconds;
+    long allocations;
+    long calls;
+};
+
+// Starts timing one call
+chrono::steady_clock::time_point
+start_call(long &allocs)
+{
+    allocs = allocations;
+    return chrono::steady_clock::now();
+}
+
+// Ends timing `calls` calls, started at `start`
+void
+end_call(Samples &samples, chrono::steady_clock::time_point start,
+         long allocs, long calls = 1)
+{
+    double seconds = chrono::duration <double> (chrono::steady_clock::now() - start).count();
+    samples.allocations += allocations - allocs; // Before the sample is stored
+    samples.seconds.push_back(seconds / calls);
+    samples.calls += calls;
+}
+
+void
+print_header()
+{
+    cout << left << setw(24) << "benchmark" << right
+         << setw(6) << "size" << setw(6) << "hand" << setw(10) << "calls"
+         << setw(14) << "median us" << setw(14) << "p99 us"
+         << setw(14) << "allocs/call" << endl;
+}
+
+void
+print_samples(string name, int size, int hand, Samples &samples)
+{
+    vector <double> &s = samples.seconds;
+    if (s.empty()) return;
+
+    sort(s.begin(), s.end());
+    int p99 = min((int) s.size() - 1, (int) ceil(0.99 * s.size()) - 1);
+
+    cout << left << setw(24) << name << right
+         << setw(6) << size << setw(6) << hand << setw(10) << samples.calls
+         << fixed << setprecision(3)
+         << setw(14) << s[s.size() / 2] * 1e6 << setw(14) << s[p99] * 1e6
+         << setprecision(1)
+         << setw(14) << (double) samples.allocations / samples.calls << endl;
+    cout.unsetf(ios::fixed);
+}
+
+// Loading of the dictionary, for the current board size. Compiled
+// dictionaries are not parsed, so create_trie is timed only on text
+// ones.
+void
+bench_load()
+{
+    Samples trie = {}, load = {};
+    Dictionary_header header;
+    bool compiled = read_dictionary_header(filename, header);
+
+    for (int run = 0; run < LOAD_RUNS; run++) {
+        long allocs;
+        auto start = start_call(allocs);
+        if (!compiled) {
+            Trie_arena arena;
+            create_trie(arena, filename, BOARD_SIZE);
+            end_call(trie, start, allocs);
+            destroy_arena(arena);
+        }
+
+        destroy_dictionary();
+        start = start_call(allocs);
+        make_dictionary(filename, minimize_dictionary);
+        end_call(load, start, allocs);
+    }
+    print_samples("create_trie", BOARD_SIZE, 0, trie);
+    print_samples("make_dictionary", BOARD_SIZE, 0, load);
+}
+
+// Dictionary lookups: every word of the dictionary, the same words
+// with the last letter changed (mostly misses), and their first halves
+// as prefixes
+void
+bench_lookups()
+{
+    vector <string> words;
+    vector <string> misses;
+    string prefix;
+    Samples hits = {}, miss = {}, prefixes = {};
+    const Tnode *last_letter;
+    long found = 0;
+
+    collect_words(dictionary, prefix, BOARD_SIZE, words);
+    for (string word : words) {
+        word.back() = 'A' + (word.back() - 'A' + 13) % 26;
+        misses.push_back(word);
+    }
+
+    for (unsigned int i = 0; i < words.size(); i += LOOKUP_BATCH) {
+        unsigned int end = min((unsigned int) words.size(), i + LOOKUP_BATCH);
+        long allocs;
+
+        auto start = start_call(allocs);
+        for (unsigned int j = i; j < end; j++)
+            found += search_word(dictionary, words[j].data(), words[j].size());
+        end_call(hits, start, allocs, end - i);
+
+        start = start_call(allocs);
+        for (unsigned int j = i; j < end; j++)
+            found += search_word(dictionary, misses[j].data(), misses[j].size());
+        end_call(miss, start, allocs, end - i);
+
+        start = start_call(allocs);
+        for (unsigned int j = i; j < end; j++)
+            found += check_prefix(last_letter, dictionary, words[j].data(), words[j].size() / 2);
+        end_call(prefixes, start, allocs, end - i);
+    }
+    print_samples("search_word hit", BOARD_SIZE, 0, hits);
+    print_samples("search_word miss", BOARD_SIZE, 0, miss);
+    print_samples("check_prefix", BOARD_SIZE, 0, prefixes);
+    sink = found;
+}
+
+// Reads the boards of the current board size and hand from the
+// corpus file. The hand to move is the one of the first player.
+void
+read_corpus(vector <Game> &corpus, vector <int> &hands)
+{
+    ifstream file(corpus_filename);
+    int size, hand, letters;
+    bool first_turn;
+
+    while (file >> size >> hand >> first_turn >> letters) {
+        Game game;
+        Player player = {"CPU", {}, 0, false};
+
+        player.letters.resize(letters);
+        for (char &letter : player.letters) file >> letter;
+
+        game.board.size = size;
+        game.board.squares.resize(size * size);
+        fill(game.board.rows, game.board.rows + MAX_BOARD_SIZE, 0);
+        fill(game.board.columns, game.board.columns + MAX_BOARD_SIZE, 0);
+        for (int y = 0; y < size; y++)
+            for (int x = 0; x < size; x++) {
+                Letter &square = game.board.at(x, y);
+                file >> square.letter >> square.layer;
+                if (square.letter == '.') {
+                    square.letter = ' ';
+                } else {
+                    game.board.rows[y] |= 1u << x;
+                    game.board.columns[x] |= 1u << y;
+                }
+            }
+        game.board.first_turn = first_turn;
+        game.board.cache.valid = false;
+
+        if (size == BOARD_SIZE && hand == PLAYER_HAND) {
+            game.players.push_back(player);
+            corpus.push_back(game);
+            hands.push_back(0);
+        }
+    }
+}
+
+// Appends the boards of the current board size and hand to the corpus
+// file
+void
+write_corpus(vector <Game> &corpus, vector <int> &hands)
+{
+    ofstream file(corpus_filename, ios::app);
+
+    for (unsigned int i = 0; i < corpus.size(); i++) {
+        Board &board = corpus[i].board;
+        vector <char> &letters = corpus[i].players[hands[i]].letters;
+
+        file << board.size << ' ' << PLAYER_HAND << ' ' << board.first_turn
+             << ' ' << letters.size();
+        for (char letter : letters) file << ' ' << letter;
+        file << endl;
+        for (int y = 0; y < board.size; y++) {
+            for (int x = 0; x < board.size; x++) {
+                Letter &square = board.at(x, y);
+                file << ' ' << (square.letter == ' ' ? '.' : square.letter)
+                     << square.layer;
+            }
+            file << endl;
+        }
+    }
+}
+
+// Plays seeded games and saves the board, with the hand of the player
+// to move, every few turns. The games are always played by the trie
+// generator on one thread, so the boards don't depend on what is
+// benchmarked. If there is a corpus file, its boards are used, and
+// the boards played are added to it, so that they stay the same when
+// the engine changes.
+void
+make_corpus(vector <Game> &corpus, vector <int> &hands)
+{
+    vector <string> names = {"CPU 1", "CPU 2"};
+    bool gaddag = use_gaddag;
+    int threads = suggestion_threads;
+
+    if (!corpus_filename.empty()) {
+        read_corpus(corpus, hands);
+        if (!corpus.empty()) return;
+    }
+
+    use_gaddag = false;
+    suggestion_threads = 1;
+    for (int g = 0; g < CORPUS_GAMES; g++) {
+        Game game;
+        int player_turn = 0;
+
+        game.seed = g + 1;
+        make_board(game);
+        make_bucket(game);
+        make_players(game, names);
+
+        for (int turn = 0; !is_game_over(game); turn++) {
+            Player &player = game.players.at(player_turn);
+            if (turn > 0 && turn % CORPUS_INTERVAL == 0) {
+                get_letters(game, player);
+                corpus.push_back(game);
+                hands.push_back(player_turn);
+            }
+            play_best_suggestion(game, player);
+            player_turn = (player_turn + 1) % game.players.size();
+        }
+    }
+    use_gaddag = gaddag;
+    suggestion_threads = threads;
+
+    if (!corpus_filename.empty()) write_corpus(corpus, hands);
+}
+
+// Cross-checks of every row in both directions, and whole suggestion
+// requests, on every board of the corpus. The cache of the board is
+// emptied before every request, so it is computed from scratch.
+void
+bench_boards()
+{
+    vector <Game> corpus;
+    vector <int> hands;
+    Samples cross_checks = {}, suggestions = {};
+    unsigned int row_checks[MAX_BOARD_SIZE];
+
+    make_corpus(corpus, hands);
+
+    for (unsigned int i = 0; i < corpus.size(); i++) {
+        Board &g_board = corpus[i].board;
+        Player &player = corpus[i].players[hands[i]];
+
+        for (int run = 0; run < BOARD_RUNS; run++) {
+            long allocs;
+            unsigned int checks = 0;
+            auto start = start_call(allocs);
+            for (bool dir : {HORIZONTAL, VERTICAL})
+                for (int y = 0; y < BOARD_SIZE; y++) {
+                    get_cross_checks(Board_view(g_board, dir), y, row_checks);
+                    for (int x = 0; x < BOARD_SIZE; x++) checks ^= row_checks[x];
+                }
+            end_call(cross_checks, start, allocs);
+            sink = checks;
+
+            g_board.cache.valid = false;
+            start = start_call(allocs);
+            get_suggestions(g_board, player, 20);
+            end_call(suggestions, start, allocs);
+        }
+    }
+    print_samples("get_cross_checks", BOARD_SIZE, PLAYER_HAND, cross_checks);
+    print_samples("get_suggestions", BOARD_SIZE, PLAYER_HAND, suggestions);
+}
+
+int
+main(int argc, char **argv)
+{
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp("-d", argv[i]) && i < (argc - 1))
+            filename = argv[++i];
+        else if (!strcmp("-m", argv[i]))
+            minimize_dictionary = true;
+        else if (!strcmp("-g", argv[i]))
+            use_gaddag = true;
+        else if (!strcmp("-j", argv[i]) && i < (argc - 1))
+            suggestion_threads = atoi(argv[++i]);
+        else if (!strcmp("-b", argv[i]) && i < (argc - 1))
+            corpus_filename = argv[++i];
+        else {
+            cout << "Usage: " << argv[0] << " [-d dictionary] [-m] [-g] [-j threads]"
+                 << " [-b boards]" << endl;
+            return 1;
+        }
+    }
+    // One thread by default, so that runs can be compared
+    if (suggestion_threads <= 0) suggestion_threads = 1;
+    loader_threads = suggestion_threads;
+
+    print_header();
+    for (int size = 10; size <= MAX_BOARD_SIZE; size += 2) {
+        BOARD_SIZE = size;
+        bench_load();
+        if (!(dictionary->mask & LETTERS_MASK)) {
+            cout << "Can't load dictionary: " << filename << endl;
+            return 1;
+        }
+        bench_lookups();
+        if (use_gaddag) make_gaddag();
+
+        for (int hand : {7, 10, 13}) {
+            PLAYER_HAND = hand;
+            bench_boards();
+        }
+
+        destroy_gaddag();
+        destroy_dictionary();
+    }
+    destroy_suggestions_pool();
+    return 0;
+}
@@ -22,16 +22,84 @@ using namespace std;
 #define HLETTER_COLOR 5         // Hand letters colors
 #define MESSAGE_COLOR 6         // Message box colors
 
+// Dictionary node masks
+#define LETTERS_MASK ((1u << 26) - 1) // One bit for every letter
+#define END_OF_WORD  (1u << 31)       // Node ends a word
+
+// GADDAG separator between the reversed and the forward part of a
+// word. It comes right after 'Z', so it is the 27th child bit.
+#define GADDAG_SEPARATOR '['
+
 // Some parameters
 int BOARD_SIZE  = 10,
     PLAYER_HAND = 7;
 
+// Biggest board size that can be chosen in settings
+#define MAX_BOARD_SIZE 18
+
+// Compiled dictionary file identification
+#define DICTIONARY_MAGIC   0x44575055 // "UPWD"
+#define DICTIONARY_VERSION 1
+
+// Trie nodes allocated at a time by a Trie_arena
+#define TRIE_ARENA_BLOCK 65536
+
+// Suggestions requests with fewer anchors or rack letters than these
+// are searched on the calling thread alone, as waking the workers
+// would cost about as much as the search
+#define PARALLEL_MIN_ANCHORS 24
+#define PARALLEL_MIN_LETTERS 5
+
 // Data structures
 
+// Dictionary node. All the nodes of a dictionary live in one
+// contiguous array. The children of a node are stored next to each
+// other, sorted by letter, starting `children` nodes away from the
+// node itself. Bit `i` of `mask` is set if the node has a child for
+// letter 'A' + i, so the child position is the popcount of the lower
+// bits.
 struct Tnode {
+    int children;
+    unsigned int mask;
+};
+
+// Trie node used only while building the dictionary. Once all the
+// words are inserted, the trie is flattened into an array of Tnodes.
+// The children of a node are a list, sorted by letter: `child` is
+// the first one and `next` is the following sibling.
+struct Bnode {
     char letter;
     bool is_end;
-    vector <Tnode*> Tchildren;
+    Bnode *child;
+    Bnode *next;
+};
+
+// Storage of the Bnodes of a trie. Nodes are taken in order from
+// blocks of TRIE_ARENA_BLOCK nodes and never freed one by one: the
+// whole trie goes away with its arena.
+struct Trie_arena {
+    vector <Bnode*> blocks;
+    unsigned int used;          // Nodes taken so far
+    Trie_arena() : used(0) {}
+};
+
+// Compiled dictionary files start with this header, followed by
+// `size` Tnodes. The first node is the root.
+struct Dictionary_header {
+    unsigned int magic;
+    unsigned int version;
+    unsigned int max_length;    // Longest word in the dictionary
+    unsigned int size;
+};
+
+// What the loaded dictionary was built from. It is loaded again only
+// if one of these changes.
+struct Dictionary_source {
+    string filename;
+    long mtime;                 // Modification time of the file
+    long size;                  // Size of the file
+    int board_size;             // Longest word kept
+    bool minimize;
 };
 
 struct Letter {
@@ -46,11 +114,170 @@ struct Player {
     bool passed;
 };
 
+// Cross-checks, cross words and anchors of every row of a board, for
+// both directions. They are indexed by [direction][y][x], with `y`
+// and `x` taken on the board as seen in that direction (see
+// Board_view). A cross word is set if a letter put on the square makes
+// a word across the row, which is worth one more point. An anchor
+// holds its left part limit, -1 if the square is not an anchor. The
+// (x, y) squares of the board that changed since the last refresh are
+// listed in `touched`.
+struct Board_cache {
+    unsigned int cross_checks[2][MAX_BOARD_SIZE][MAX_BOARD_SIZE];
+    bool cross_words[2][MAX_BOARD_SIZE][MAX_BOARD_SIZE];
+    int anchors[2][MAX_BOARD_SIZE][MAX_BOARD_SIZE];
+    vector <pair <int, int>> touched;
+    bool valid;                 // False if everything must be recomputed
+    bool on_first_turn;         // Value of first_turn when computed
+};
+
+// Game board. All the squares are stored in one buffer, row after
+// row. Which squares hold a letter is also kept as bit planes: bit
+// `x` of `rows[y]` and bit `y` of `columns[x]` are set if square (x,
+// y) is not empty, so a whole row or column is scanned at once.
+struct Board {
+    int size;
+    vector <Letter> squares;
+    unsigned int rows[MAX_BOARD_SIZE];
+    unsigned int columns[MAX_BOARD_SIZE];
+    bool first_turn;            // No word was inserted yet
+    Board_cache cache;          // Suggestions data of the board
+
+    Letter &at(int x, int y) { return squares[y * size + x]; }
+};
+
+// Square covered by a move, as it was before
+struct Move_square {
+    int x;                      // Square on the board
+    int y;
+    Letter previous;
+    int hand_index;             // Place of the letter in the hand
+};
+
+// What a turn changed, so that it can be undone and played again
+// without copying the board. `squares` are in the order the letters
+// were placed.
+struct Move {
+    int player;                 // Index of the player
+    int drawn;                  // Letters drawn when the turn started
+    bool was_passed;            // `passed` of the player before
+    bool passed;                // The player passed
+    bool first_turn;            // `first_turn` of the board before
+    int points;                 // Points given by the word
+    int x;                      // Word, as it was inserted
+    int y;
+    bool direction;
+    char word[MAX_BOARD_SIZE];
+    int length;
+    Move_square squares[MAX_BOARD_SIZE];
+    int placed;                 // Letters put on the board
+};
+
+// State of one game. Games share nothing but the dictionaries, that
+// are only read, so many of them can be played at the same time.
+struct Game {
+    Board board;
+    vector <char> bucket;
+    vector <Player> players;
+    unsigned int seed;          // State of the random numbers of the game
+    Move turn;                  // Turn being played
+    vector <Move> moves;        // Journal of the turns played
+    int turns;                  // Turns of the journal played, the
+                                // next ones can be played again
+};
+
+// Outcome of a game played without the tui
+struct Game_result {
+    vector <int> points;        // Final points of every player
+    int winner;                 // Index of the winner, -1 on a draw
+    int moves;                  // Words inserted
+};
+
+// A board seen in direction `dir`. Square (x, y) of a HORIZONTAL view
+// is square (x, y) of the board, while square (x, y) of a VERTICAL
+// view is square (y, x): the rows of a vertical view are the columns
+// of the board, read in place through the strides.
+struct Board_view {
+    Board *board;
+    bool dir;
+    int x_stride;
+    int y_stride;
+
+    Board_view(Board &brd, bool direction)
+        : board(&brd), dir(direction),
+          x_stride((direction == HORIZONTAL) ? 1 : brd.size),
+          y_stride((direction == HORIZONTAL) ? brd.size : 1) {}
+
+    Letter &at(int x, int y) const { return board->squares[y * y_stride + x * x_stride]; }
+    // Occupancy of row `y` and of column `x` of the view
+    unsigned int row(int y) const {
+        return (dir == HORIZONTAL) ? board->rows[y] : board->columns[y];
+    }
+    unsigned int column(int x) const {
+        return (dir == HORIZONTAL) ? board->columns[x] : board->rows[x];
+    }
+};
+
 struct Suggestion {
     string word;
     int x;
     int y;
     bool direction;
+    int points;
+};
+
+// Letters of a hand, as a count for every letter. Bit `i` of `mask`
+// is set while there is at least one letter 'A' + i, so it can be
+// matched against the children mask of a dictionary node.
+struct Rack {
+    int count[26];
+    unsigned int mask;
+
+    Rack(vector <char> &letters) : count(), mask(0) {
+        for (char letter : letters) put_back(letter);
+    }
+    void take(char letter) {
+        if (--count[letter - 'A'] == 0) mask &= ~(1u << (letter - 'A'));
+    }
+    void put_back(char letter) {
+        count[letter - 'A']++;
+        mask |= 1u << (letter - 'A');
+    }
+};
+
+// Suggestion kept while searching. The word is stored in place, so
+// keeping it allocates nothing.
+struct Candidate {
+    char word[MAX_BOARD_SIZE];
+    int length;
+    int x;
+    int y;
+    bool direction;
+    int points;
+};
+
+// State of one suggestions search. Every worker has its own, so rows
+// can be searched in parallel: while suggestions are generated the
+// board and its cache are only read.
+struct Search {
+    Board_view board;           // Board as seen in the row direction
+    int y;                      // Row being searched
+    unsigned int *cross_checks; // Cross-checks of row `y`
+    bool *cross_words;          // Cross words of row `y`
+    Rack rack;                  // Letters that can still be placed
+    char word[MAX_BOARD_SIZE];  // Word being built
+    int length;                 // Letters in `word`
+    int points;                 // Points of the letters in `word`
+    int placed;                 // Letters of `word` from the rack
+    int stacked;                // Letters of `word` stacked on others
+    int count;                  // Number of suggestions to keep
+    vector <Candidate> best;    // Heap of the best suggestions so far,
+                                // the worst one on top
+
+    Search(Board &brd, vector <char> &letters, int n)
+        : board(brd, HORIZONTAL), y(0), cross_checks(nullptr), cross_words(nullptr),
+          rack(letters), word(), length(0), points(0), placed(0),
+          stacked(0), count(n) {}
 };
 
 #endif
@@ -15,26 +15,26 @@
 
 // Board manager
 
-// Board declaration
-vector <vector <Letter>> board;
-
 void
-make_board()
+make_board(Game &game)
 {
-    board.resize(BOARD_SIZE);
-    for (int i = 0; i < BOARD_SIZE; i++) {
-        board.at(i).resize(BOARD_SIZE);
-        for (int j = 0; j < BOARD_SIZE; j++) {
-            board.at(i).at(j) = {' ', 0};
-        }
-    }
+    game.board.size = BOARD_SIZE;
+    game.board.squares.assign(BOARD_SIZE * BOARD_SIZE, {' ', 0});
+    fill(game.board.rows, game.board.rows + MAX_BOARD_SIZE, 0);
+    fill(game.board.columns, game.board.columns + MAX_BOARD_SIZE, 0);
+    game.board.first_turn = true;
+    game.board.cache.valid = false;
+    game.board.cache.touched.clear();
+    game.moves.clear();         // The journal of the turns too
+    game.turns = 0;
     return;
 }
 
 void
-destroy_board()
+destroy_board(Game &game)
 {
-    board.clear();
+    game.board.squares.clear();
+    game.moves.clear();
 }
 
 // Insertion direction of words
@@ -44,13 +44,12 @@ void toggle_w_direction() { w_direction = !w_direction; }
 
 // Bucket manager
 
-vector <char> bucket;
-
-int myrandom (int i) { return rand()%i; }
+// Random number below `i`, from the random numbers of `game`
+int game_random(Game &game, int i) { return rand_r(&game.seed) % i; }
 
 // Function for bucket initialization
 void
-make_bucket()
+make_bucket(Game &game)
 {
     map <int, vector <char>> letters_map;
 
@@ -67,81 +66,62 @@ make_bucket()
     for (auto const &t : letters_map)
         for (int i = 0; i < t.first; i++)
             for (auto c : t.second)
-                bucket.push_back(c);
+                game.bucket.push_back(c);
 
-    random_shuffle(bucket.begin(), bucket.end(), myrandom);
+    random_shuffle(game.bucket.begin(), game.bucket.end(),
+                   [&game](int i) { return game_random(game, i); });
     return;
 }
 
 void
-destroy_bucket()
+destroy_bucket(Game &game)
 {
-    bucket.clear();
+    game.bucket.clear();
 }
 
 // Function that refills the hand of the player if the bucket is not
 // empty
 bool
-get_letters(Player &player)
+get_letters(Game &game, Player &player)
 {
-    if (bucket.empty()) return false;
+    if (game.bucket.empty()) return false;
 
     while ((int) player.letters.size() < PLAYER_HAND
-           && !bucket.empty()) {
+           && !game.bucket.empty()) {
         // random_shuffle(bucket.begin(), bucket.end());
-        player.letters.push_back(bucket.back());
-        bucket.pop_back();
+        player.letters.push_back(game.bucket.back());
+        game.bucket.pop_back();
     }
     return true;
 }
 
 // Player manager
 
-vector <Player> players;
-
 // This function takes the data, from a string of names, and puts it
 // into the datastruct
 void
-make_players(vector <string> player_names)
+make_players(Game &game, vector <string> player_names)
 {
     for (string name : player_names) {
         Player new_player;
         new_player.name = name;
         new_player.points = 0;
         new_player.passed = false;
-        get_letters(new_player);
+        get_letters(game, new_player);
 
-        players.push_back(new_player);
+        game.players.push_back(new_player);
     }
     return;
 }
 
 void
-destroy_players()
+destroy_players(Game &game)
 {
-    players.clear();
+    game.players.clear();
 }
 
 // Game manager
 
-bool first_turn = true;
-
-// Transpose board
-void
-transpose(vector <vector <Letter>> &brd)
-{
-    Letter temp;
-
-    for (int i = 0; i < BOARD_SIZE; i++) {
-        for (int j = i; j < BOARD_SIZE; j++) {
-
-            temp = brd.at(i).at(j);
-            brd.at(i).at(j) = brd.at(j).at(i);
-            brd.at(j).at(i) = temp;
-        }
-    }
-}
-
 bool
 is_letter_correct(vector <char> letters, char letter)
 {
@@ -152,74 +132,64 @@ is_letter_correct(vector <char> letters, char letter)
 // Function that manages letter exchange. If bucket is not empty, it
 // swaps given letter with the one from the bucket
 bool
-exchange_letter(vector <char> &letters, char letter)
+exchange_letter(Game &game, vector <char> &letters, char letter)
 {
-    if (bucket.empty()) return false;
+    if (game.bucket.empty()) return false;
 
     vector <char>::iterator found = find(letters.begin(), letters.end(), letter);
     char temp = *found;
-    *found = bucket.back();
-    bucket.pop_back();
-    bucket.push_back(temp);
-    random_shuffle(bucket.begin(), bucket.end());
+    *found = game.bucket.back();
+    game.bucket.pop_back();
+    game.bucket.push_back(temp);
+    random_shuffle(game.bucket.begin(), game.bucket.end(),
+                   [&game](int i) { return game_random(game, i); });
     return true;
 }
 
-// Gets the word passing through a precise square
-string
-get_downword(vector <vector <Letter>> &brd, int x, int y)
+// Given the occupancy `line` of a row or column, returns the first
+// square of the letters right before square `i`, `i` itself if there
+// are none
+inline int
+run_start(unsigned int line, int i)
 {
-    int temp_y = y;
-    string new_downword;
-
-    while (temp_y >= 0
-           && brd.at(temp_y).at(x).letter != ' ') { // Find upword start
-        temp_y--;
-    }
-    temp_y++;
-
-    while (temp_y < BOARD_SIZE
-           && brd.at(temp_y).at(x).letter != ' ') { // Find upword end
-        new_downword.push_back(brd.at(temp_y).at(x).letter);
-        temp_y++;
-    }
-    return new_downword;
+    unsigned int empty = ~line & ((1u << i) - 1);
+    return empty ? 32 - __builtin_clz(empty) : 0;
 }
 
-// Get the downword than search it in the dictionary
-bool
-check_downword(vector <vector <Letter>> &brd, int x, int y, char letter)
+// Returns the square after the letters right after square `i`. The
+// squares past the board are empty.
+inline int
+run_end(unsigned int line, int i)
 {
-    char prev_letter = brd.at(y).at(x).letter;
-    string new_downword;
-
-    brd.at(y).at(x).letter = letter;
-    new_downword = get_downword(brd, x, y);
-    brd.at(y).at(x).letter = prev_letter;
-
-    return search_word(dictionary, new_downword);
+    return i + 1 + __builtin_ctz(~line >> (i + 1));
 }
 
-// All the actions that have to be done when a letter is placed
+// All the actions that have to be done when a letter is placed. The
+// square is marked as touched in the board cache.
 void
-place_letter(vector <vector <Letter>> &brd, int x, int y,
+place_letter(Board_view brd, int x, int y,
              vector <char> &letters, vector <char>::iterator letter)
 {
-    brd.at(y).at(x).letter = *letter;
+    brd.at(x, y).letter = *letter;
     letters.erase(letter);
-    brd.at(y).at(x).layer++;
+    brd.at(x, y).layer++;
+
+    pair <int, int> square = (brd.dir == HORIZONTAL) ? make_pair(x, y) : make_pair(y, x);
+    brd.board->rows[square.second] |= 1u << square.first;
+    brd.board->columns[square.first] |= 1u << square.second;
+    brd.board->cache.touched.push_back(square);
 }
 
 // First turn conditions. The word must have tiles placed in the
 // middle of the board
 bool
-check_first_turn(int x, int y, string word)
+check_first_turn(int x, int y, int length)
 {
     int middle_x = BOARD_SIZE / 2;
     int middle_y = BOARD_SIZE / 2;
     bool even = (BOARD_SIZE % 2 == 0);
     bool found = false;
-    int size = ((int) word.size()) + x;
+    int size = length + x;
 
     if (even) {
         if (middle_y == y || (middle_y - 1) == y) {
@@ -241,18 +211,24 @@ check_first_turn(int x, int y, string word)
 
 // Looks if the square under and above are empty
 bool
-check_updown_not_empty(vector <vector <Letter>> &brd, int x, int y)
+check_updown_not_empty(Board_view brd, int x, int y)
 {
-    // Regola del corto circuito
-    return ((y > 0 && brd.at(y - 1).at(x).letter != ' ')
-            || (y < (BOARD_SIZE - 1) && brd.at(y + 1).at(x).letter != ' '));
+    // Bits y - 1 and y + 1 of the column
+    return brd.column(x) & ((5u << y) >> 1);
 }
 
-// This function checks if the word is valid in that place, places it,
-// and adds points to the player
+// Brings the cross-checks and cross words of the board cache up to
+// date. Defined with the suggestions.
+void refresh_board_cache(Board &g_board);
+
+// This function checks if the `length` letters of `word` are a valid
+// word in that place, given the player hand `letters`, and computes
+// the points it is worth. The words made across the row, and their
+// points, are read from the board cache. Nothing but the cache is
+// changed, neither the board nor the hand.
 bool
-insert_word_to_board(vector <vector <Letter>> &virt_board,
-                     int x, int y, string word, Player &player)
+score_word(Board_view virt_board, int x, int y, const char *word, int length,
+           vector <char> &letters, int &points)
 {
     // Checker variables
     bool word_connected = false; // Check if the word that we are
@@ -263,61 +239,67 @@ insert_word_to_board(vector <vector <Letter>> &virt_board,
                                     // word that we are trying to
                                     // insert.
     bool letter_placed = false;     // Check if at least one letter was placed
+    int hand[26] = {0};             // Count of every letter left in hand
+    int hand_size = letters.size();
+    bool first_turn = virt_board.board->first_turn;
+
+    points = 0;
+    for (char chr : letters) hand[chr - 'A']++;
 
     // First turn check for the center of board
-    if (first_turn && !check_first_turn(x, y, word)) return false;
+    if (first_turn && !check_first_turn(x, y, length)) return false;
     // If word is empty or it's bigger then board size, don't put the word
-    if (word.empty() || word.size() > (unsigned int) BOARD_SIZE) return false;
+    if (length == 0 || length > BOARD_SIZE) return false;
     // If the word is not in the dictionary, don't put the word
-    if (!search_word(dictionary, word)) return false;
+    if (!search_word(dictionary, word, length)) return false;
 
     // Check left part
-    if (x > 0 && virt_board.at(y).at(x - 1).letter != ' ') return false;
+    if (x > 0 && virt_board.at(x - 1, y).letter != ' ') return false;
     // Check right part
-    int last_letter = x + word.size() - 1;
+    int last_letter = x + length - 1;
     if (last_letter >= BOARD_SIZE) return false;
     if (last_letter != (BOARD_SIZE - 1)
-        && virt_board.at(y).at(last_letter + 1).letter != ' ') return false;
+        && virt_board.at(last_letter + 1, y).letter != ' ') return false;
 
-    for (char chr : word) {
-        vector <char>::iterator hand_val = find(player.letters.begin(), player.letters.end(), chr);
-        char board_val = virt_board.at(y).at(x).letter;
-        bool in_hand = (hand_val != player.letters.end());
+    refresh_board_cache(*virt_board.board);
+    unsigned int *cross_checks = virt_board.board->cache.cross_checks[virt_board.dir][y];
+    bool *cross_words = virt_board.board->cache.cross_words[virt_board.dir][y];
+
+    for (int i = 0; i < length; i++) {
+        char chr = word[i];
+        char board_val = virt_board.at(x, y).letter;
+        bool in_hand = (hand[chr - 'A'] > 0);
 
         if (in_hand) {
             if (board_val == ' ') {
-                if (check_updown_not_empty(virt_board, x, y)) {
-                    if (check_downword(virt_board, x, y, *hand_val)) {
-                        place_letter(virt_board, x, y, player.letters, hand_val);
+                if (cross_words[x]) {
+                    if (cross_checks[x] & letter_bit(chr)) {
                         letter_placed = true;
                         word_connected = true;
-                        player.points += 3;
+                        points += 3;
                     } else {
                         return false;
                     }
                 } else {
-                    place_letter(virt_board, x, y, player.letters, hand_val);
                     letter_placed = true;
-                    player.points += 2;
+                    points += 2;
                 }
             } else if (board_val != chr) {
-                if (virt_board.at(y).at(x).layer < 5) {
-                    if (check_updown_not_empty(virt_board, x, y)) {
-                        if (check_downword(virt_board, x, y, *hand_val)) {
-                            place_letter(virt_board, x, y, player.letters, hand_val);
+                if (virt_board.at(x, y).layer < 5) {
+                    if (cross_words[x]) {
+                        if (cross_checks[x] & letter_bit(chr)) {
                             letter_placed = true;
                             upwords_count++;
                             word_connected = true;
-                            player.points += 2;
+                            points += 2;
                         } else {
                             return false;
                         }
                     } else {
-                        place_letter(virt_board, x, y, player.letters, hand_val);
                         letter_placed = true;
                         upwords_count++;
                         word_connected = true;
-                        player.points += 1;
+                        points += 1;
                     }
                 } else {
                     return false;
@@ -325,59 +307,261 @@ insert_word_to_board(vector <vector <Letter>> &virt_board,
             } else {
                 word_connected = true;
             }
+            if (board_val != chr) { // The letter leaves the hand
+                hand[chr - 'A']--;
+                hand_size--;
+            }
         } else if (board_val != chr) {
             return false;
         } else {
-            player.points += 1;
+            points += 1;
             word_connected = true;
         }
         x++;
     }
     // If all letters were used, add 20 points
-    if (player.letters.empty()) player.points += 20;
+    if (hand_size == 0) points += 20;
 
     // if (!first_turn && !word_connected) return false;
     // Thanks De Morgan and Carlo for boolean algebra
     if (!(first_turn || word_connected)) return false;
-    if (upwords_count == word.size()) return false;
+    if (upwords_count == (unsigned int) length) return false;
 
     if (!letter_placed) return false;
 
     return true;
 }
 
-// Creates a temporary board so we can work on that in a not
-// destructive way
 bool
-check_word(string word, Player &player, int x, int y)
+score_word(Board_view virt_board,
+           int x, int y, string &word, vector <char> &letters, int &points)
+{
+    return score_word(virt_board, x, y, word.data(), word.size(), letters, points);
+}
+
+// This function checks if the word is valid in that place, places it,
+// and adds points to the player. The word goes along the rows of the
+// view, so a VERTICAL view inserts it vertically. What changed is
+// recorded in `move`, so that undo_move() can take it back.
+bool
+apply_move(Board_view virt_board,
+           int x, int y, string word, Player &player, Move &move)
+{
+    int points;
+
+    if (!score_word(virt_board, x, y, word, player.letters, points)) return false;
+
+    move.x = x;
+    move.y = y;
+    move.direction = virt_board.dir;
+    move.length = word.copy(move.word, MAX_BOARD_SIZE);
+    move.points = points;
+    move.first_turn = virt_board.board->first_turn;
+    move.placed = 0;
+
+    for (char chr : word) {
+        Letter &square = virt_board.at(x, y);
+        if (square.letter != chr) {
+            vector <char>::iterator letter = find(player.letters.begin(),
+                                                  player.letters.end(), chr);
+            Move_square &changed = move.squares[move.placed++];
+            changed.x = (virt_board.dir == HORIZONTAL) ? x : y;
+            changed.y = (virt_board.dir == HORIZONTAL) ? y : x;
+            changed.previous = square;
+            changed.hand_index = letter - player.letters.begin();
+            place_letter(virt_board, x, y, player.letters, letter);
+        }
+        x++;
+    }
+    player.points += points;
+    virt_board.board->first_turn = false;
+    return true;
+}
+
+bool
+insert_word_to_board(Board_view virt_board,
+                     int x, int y, string word, Player &player)
 {
-    vector <vector <Letter>> temp_board(board);
-    Player temp_player = player;
+    Move move;
+
+    return apply_move(virt_board, x, y, word, player, move);
+}
 
-    return insert_word_to_board(temp_board, x, y, word, temp_player);
+// Takes back `move`, the last one applied by `player`. Only the
+// squares of the move change, and they are marked as touched in the
+// board cache.
+void
+undo_move(Board &board, Player &player, Move &move)
+{
+    for (int i = move.placed - 1; i >= 0; i--) {
+        Move_square &changed = move.squares[i];
+        Letter &square = board.at(changed.x, changed.y);
+
+        player.letters.insert(player.letters.begin() + changed.hand_index, square.letter);
+        square = changed.previous;
+        if (square.letter == ' ') {
+            board.rows[changed.y] &= ~(1u << changed.x);
+            board.columns[changed.x] &= ~(1u << changed.y);
+        }
+        board.cache.touched.push_back(make_pair(changed.x, changed.y));
+    }
+    player.points -= move.points;
+    board.first_turn = move.first_turn;
+}
+
+// Checks if the player can insert the word in direction `dir`,
+// without touching the board
+bool
+check_word(Board &g_board, string word, Player &player, int x, int y, bool dir)
+{
+    int points;
+
+    return score_word(Board_view(g_board, dir), x, y, word, player.letters, points);
+}
+
+// Turn journal. A turn starts with start_turn() and ends with
+// play_turn(), pass_turn() or a letter exchange. The turns played are
+// recorded in the journal of the game, so they can be undone and
+// played again. Exchanges shuffle the bucket and can't be undone:
+// they empty the journal.
+
+// Starts the turn of player `player_index`, who draws letters
+void
+start_turn(Game &game, int player_index)
+{
+    Player &player = game.players.at(player_index);
+    int hand_size = player.letters.size();
+
+    game.turn.player = player_index;
+    game.turn.was_passed = player.passed;
+    game.turn.passed = false;
+    game.turn.first_turn = game.board.first_turn;
+    game.turn.points = 0;
+    game.turn.length = 0;
+    game.turn.placed = 0;
+
+    player.passed = false;
+    get_letters(game, player);
+    game.turn.drawn = player.letters.size() - hand_size;
+}
+
+// Ends the current turn. Until the next one starts, undoing takes
+// back no letters drawn.
+void
+close_turn(Game &game)
+{
+    game.turn.drawn = 0;
+    game.turn.was_passed = game.players.at(game.turn.player).passed;
+}
+
+// Adds the current turn to the journal. The turns that were undone
+// can't be played again anymore.
+void
+record_turn(Game &game)
+{
+    game.moves.resize(game.turns);
+    game.moves.push_back(game.turn);
+    game.turns++;
+    close_turn(game);
+}
+
+// Ends the turn inserting `word`. Returns false, and the turn goes
+// on, if the word can't be inserted.
+bool
+play_turn(Game &game, Board_view virt_board, int x, int y, string word)
+{
+    Player &player = game.players.at(game.turn.player);
+
+    if (!apply_move(virt_board, x, y, word, player, game.turn)) return false;
+    record_turn(game);
+    return true;
+}
+
+void
+pass_turn(Game &game)
+{
+    game.players.at(game.turn.player).passed = true;
+    game.turn.passed = true;
+    record_turn(game);
+}
+
+void
+forget_turns(Game &game)
+{
+    game.moves.clear();
+    game.turns = 0;
+}
+
+// Undoes the last turn of the journal. The letters drawn in the
+// current turn go back in the bucket, and the last turn becomes the
+// current one again, as it was after its letters were drawn. Returns
+// false if there is no turn to undo.
+bool
+undo_turn(Game &game)
+{
+    if (game.turns == 0) return false;
+
+    Player &current = game.players.at(game.turn.player);
+    for (int i = 0; i < game.turn.drawn; i++) {
+        game.bucket.push_back(current.letters.back());
+        current.letters.pop_back();
+    }
+    current.passed = game.turn.was_passed;
+
+    Move &last = game.moves.at(--game.turns);
+    Player &player = game.players.at(last.player);
+    undo_move(game.board, player, last);
+    player.passed = false;
+
+    game.turn = last;
+    game.turn.passed = false;
+    game.turn.points = 0;
+    game.turn.length = 0;
+    game.turn.placed = 0;
+    return true;
+}
+
+// Plays again the current turn as it was before it was undone.
+// Returns false if there is no turn to play again.
+bool
+redo_turn(Game &game)
+{
+    if (game.turns == (int) game.moves.size()) return false;
+
+    Move &next = game.moves.at(game.turns);
+    if (next.passed) {
+        game.players.at(game.turn.player).passed = true;
+        game.turn.passed = true;
+    } else if (!apply_move(Board_view(game.board, next.direction), next.x, next.y,
+                           string(next.word, next.length),
+                           game.players.at(game.turn.player), game.turn))
+        return false;
+    game.turns++;
+    close_turn(game);
+    return true;
 }
 
 // Check if the condition for a game over occur
 bool
-is_game_over()
+is_game_over(Game &game)
 {
     bool all_passed = true;
     bool not_empty_hands = true;
-    for (Player p : players) {
+    for (Player p : game.players) {
         all_passed = (all_passed && p.passed);
         not_empty_hands = (not_empty_hands && (bool) p.letters.size());
     }
-    return ((!not_empty_hands && bucket.empty()) || all_passed);
+    return ((!not_empty_hands && game.bucket.empty()) || all_passed);
 }
 
 // Just returns the Player struct with more points
 Player
-get_winner()
+get_winner(Game &game)
 {
-    Player winner = players.at(0);
+    Player winner = game.players.at(0);
     winner.points -= (winner.letters.size() * 5);
 
-    for (Player &current : players) {
+    for (Player &current : game.players) {
         current.points -= (current.letters.size() * 5);
         if (current.points > winner.points) winner = current;
     }
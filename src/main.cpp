@@ -9,14 +9,26 @@
 // Local includes
 #include "data_structs_n_constants.h"
 #include "game_manager.cpp"
+#include "simulation.cpp"
 #include "suggestions.cpp"
 #include "trie_manager.cpp"
 #include "tui_manager.cpp"
 
 using namespace std;
 
+// The game played in the tui
+Game game;
+
 // We removed "e'" from dictionary, because it's useless
 string filename = "dictionary.txt";
+// Store the dictionary as a minimized word graph
+bool minimize_dictionary = false;
+// If not empty, compile the dictionary to this file and exit
+string compiled_filename;
+// If positive, play this many headless games and exit
+int simulated_games = 0;
+// Random seed, the current time if not given
+unsigned int random_seed = (unsigned int) time(NULL);
 
 // Function that takes and manages specific run- arguments like -d and
 // -h
@@ -31,6 +43,15 @@ parse_arguments(int argc, char **argv)
                  << "Accepts the following flags:" << endl
                  << "  -d  dictionary  File containing dictionary words separated by newlines" << endl
                  << "                  (Default: dictionary.txt)" << endl
+                 << "                  or compiled dictionary made with -c" << endl
+                 << "  -c  output      Compile the dictionary to file output and exit" << endl
+                 << "  -m              Minimize the dictionary (less memory, slower loading)" << endl
+                 << "  -g              Use the GADDAG suggestions generator" << endl
+                 << "  -S  games       Play games without the interface, every player" << endl
+                 << "                  using the best suggestion, then show scores and speed" << endl
+                 << "  -r  seed        Random seed (Default: current time)" << endl
+                 << "  -j  threads     Threads for loading and suggestions, and games at the same" << endl
+                 << "                  time with -S (Default: one for every core)" << endl
                  << "  -h              Show this help message" << endl;
             exit(0);
         }
@@ -43,6 +64,44 @@ parse_arguments(int argc, char **argv)
                 exit(1);
             }
         }
+        else if (!strcmp("-c", argv[i])) {
+            if (i < (argc - 1)) {
+                compiled_filename = argv[i + 1];
+            } else {
+                cout << "Wrong usage. See -h for help" << endl;
+                exit(1);
+            }
+        }
+        else if (!strcmp("-m", argv[i])) {
+            minimize_dictionary = true;
+        }
+        else if (!strcmp("-g", argv[i])) {
+            use_gaddag = true;
+        }
+        else if (!strcmp("-S", argv[i])) {
+            if (i < (argc - 1) && atoi(argv[i + 1]) > 0) {
+                simulated_games = atoi(argv[i + 1]);
+            } else {
+                cout << "Wrong usage. See -h for help" << endl;
+                exit(1);
+            }
+        }
+        else if (!strcmp("-j", argv[i])) {
+            if (i < (argc - 1) && atoi(argv[i + 1]) > 0) {
+                suggestion_threads = game_threads = loader_threads = atoi(argv[i + 1]);
+            } else {
+                cout << "Wrong usage. See -h for help" << endl;
+                exit(1);
+            }
+        }
+        else if (!strcmp("-r", argv[i])) {
+            if (i < (argc - 1)) {
+                random_seed = (unsigned int) strtoul(argv[i + 1], nullptr, 10);
+            } else {
+                cout << "Wrong usage. See -h for help" << endl;
+                exit(1);
+            }
+        }
     }
 }
 
@@ -79,7 +138,7 @@ initialize_players()
     }
 
     if (accept_players(names, count))
-        make_players(names);
+        make_players(game, names);
     else
         initialize_players();
     return;
@@ -100,7 +159,7 @@ ask_exchange_letter(Player &player)
     temp_string += temp_char;
     temp_string += "? [/no]";
     if (temp_char != ' ' && get_input(temp_string, 2) != "no") {
-        if (!exchange_letter(player.letters, temp_char)) {
+        if (!exchange_letter(game, player.letters, temp_char)) {
             show_message({"The bucket is empty.", "We are really sorry! :("});
             return false;
         } else
@@ -110,11 +169,12 @@ ask_exchange_letter(Player &player)
 }
 
 // Prompts to check, if the word is correct in that spon and
-// direction. Inserts the word if the player really wants it
+// direction. Inserts the word if the player really wants it. `x` and
+// `y` are taken on the board as seen in the insertion direction.
 bool
 check_n_insert(string word, Player &player, int x, int y)
 {
-    if (check_word(word, player, x, y)) {
+    if (check_word(game.board, word, player, x, y, w_direction)) {
         string prompt = "Insert " + word + " ";
         if (w_direction == VERTICAL)
             prompt += "vertically at (x " + to_string(1 + y) + " y " + to_string(1 + x);
@@ -123,10 +183,9 @@ check_n_insert(string word, Player &player, int x, int y)
         prompt += ") [/no]";
 
         if (get_input(prompt, 2) != "no"
-            && insert_word_to_board(board, x, y, word, player)) {
-            if (first_turn) first_turn = false;
+            && play_turn(game, Board_view(game.board, w_direction), x, y, word))
             return true;
-        } else
+        else
             return false;
     } else {
         show_message({"The word '" + word + "' is not valid"});
@@ -145,31 +204,29 @@ ask_word_insertion(Player &player)
     int y = board_cursor_y;
     bool result;
 
-    if (w_direction == VERTICAL) {
-        transpose(board);
+    if (w_direction == VERTICAL)
         result = check_n_insert(word, player, y, x);
-        transpose(board);
-    } else
+    else
         result = check_n_insert(word, player, x, y);
 
     return result;
 }
 
-// every turn
-void
+// every turn, started with start_turn(). Returns false if the player
+// undid the last turn instead of playing.
+bool
 player_play(Player &player, int player_index)
 {
     bool player_loop = true;
+    bool played = true;
     vector <string> suggestions;
 
-    player.passed = false;
-    get_letters(player);
     // Temp
     string temp_hand;
     // Temp
 
     int ch;
-    update_screen(board, players, suggestions, player_index);
+    update_screen(game.board, game.players, suggestions, player_index);
     while (player_loop) {
         switch (ch = getch()) {
         case KEY_UP:
@@ -187,7 +244,9 @@ player_play(Player &player, int player_index)
         case 'h':
             show_message({"h for help", "d to change insertion direction",
                           "i to insert", "p to pass", "e to exchange",
-                          "s for suggestions", "arrows to move"});
+                          "s for suggestions", "t for suggestions stats",
+                          "u to undo the last turn", "r to redo it",
+                          "arrows to move"});
             break;
         case 'i':
             player_loop = !ask_word_insertion(player);
@@ -197,15 +256,32 @@ player_play(Player &player, int player_index)
             break;
         case 'p':
             if (get_input("Pass? [/no]", 2) != "no") {
-                player.passed = true;
+                pass_turn(game);
                 player_loop = false;
             }
             break;
         case 'e':
             player_loop = !ask_exchange_letter(player);
+            if (!player_loop) forget_turns(game);
+            break;
+        case 'u':
+            if (undo_turn(game))
+                played = player_loop = false;
+            else
+                show_message({"There is no turn to undo."});
+            break;
+        case 'r':
+            if (redo_turn(game))
+                player_loop = false;
+            else
+                show_message({"There is no turn to redo."});
             break;
         case 's':
-            suggestions = get_suggestions(board, player);
+            suggestions = format_suggestions(get_suggestions(game.board, player,
+                                                             suggestions_window_lines()));
+            break;
+        case 't':
+            show_message(get_stats_lines());
             break;
             // Temporary god mode
         // case 'c':
@@ -217,9 +293,9 @@ player_play(Player &player, int player_index)
         default:
             break;
         }
-        update_screen(board, players, suggestions, player_index);
+        update_screen(game.board, game.players, suggestions, player_index);
     }
-    return;
+    return played;
 }
 
 // Game loop - returns the winner
@@ -227,40 +303,42 @@ Player
 game_loop()
 {
     bool game_is_over = false;
-    int player_count = players.size();
-    int player_turn = 0;
+    int player_count = game.players.size();
 
+    start_turn(game, 0);
     while (!game_is_over) {
-        player_play(players.at(player_turn), player_turn);
-        player_turn = (player_turn + 1) % player_count;
-        game_is_over = is_game_over();
+        int player_turn = game.turn.player;
+
+        // After an undo, the turn that was undone is played again
+        if (player_play(game.players.at(player_turn), player_turn)) {
+            game_is_over = is_game_over(game);
+            if (!game_is_over) start_turn(game, (player_turn + 1) % player_count);
+        }
     }
 
-    return get_winner();
+    return get_winner(game);
 }
 
 // First function to be called after the main. It initializes the
-// borad, dictionary, calls the game_loop(), displays the winner
+// borad, dictionary, calls the game_loop(), displays the winner. The
+// dictionary stays loaded for the next game.
 void
 start_game()
 {
-    make_board();
-    make_bucket();
+    game.seed = rand();
+    make_board(game);
+    make_bucket(game);
     initialize_players();
-    first_turn = true;
 
-    // Only once, only you (maybe clear this later)
     clear();
     mvprintw(current_height/2, current_width/2 - 9, "Loading dictionary...");
     refresh();
-    // #############################
-    make_dictionary(filename);  // #
-    // #############################
+    load_dictionary(filename, minimize_dictionary, use_gaddag);
     clear();
     refresh();
 
 
-    set_minimum_width(get_names_width(players));
+    set_minimum_width(get_names_width(game.players));
     initialize_windows();
 
     Player winner = game_loop();
@@ -270,10 +348,9 @@ start_game()
     };
     show_message(winner_message);
 
-    destroy_board();
-    destroy_bucket();
-    destroy_players();
-    destroy_dictionary();
+    destroy_board(game);
+    destroy_bucket(game);
+    destroy_players(game);
     destroy_windows();
 }
 
@@ -284,8 +361,22 @@ main(int argc, char **argv)
     string option;
     string setting;
 
+    atexit(dump_stats);
     parse_arguments(argc, argv);
-    srand((unsigned int) time(NULL));
+    if (!compiled_filename.empty()) {
+        if (!compile_dictionary(filename, compiled_filename)) {
+            cout << "Can't compile dictionary " << filename << " to "
+                 << compiled_filename << endl;
+            return 1;
+        }
+        cout << "Compiled dictionary: " << compiled_filename << endl;
+        return 0;
+    }
+    srand(random_seed);
+    if (simulated_games > 0) {
+        simulate_games(simulated_games, random_seed, filename, minimize_dictionary);
+        return 0;
+    }
     init_tui();
 
     while (option != "Exit") {
@@ -313,5 +404,8 @@ main(int argc, char **argv)
     }
 
     end_tui();
+    destroy_suggestions_pool();
+    destroy_gaddag();
+    destroy_dictionary();
     return 0;
 }
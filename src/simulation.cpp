@@ -0,0 +1,173 @@
+// Headless games, where every player is the suggestions engine
+
+#ifndef SIMULATION_CPP
+#define SIMULATION_CPP
+
+// Includes
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <thread>
+#include <vector>
+#include <string>
+
+// Local includes
+#include "data_structs_n_constants.h"
+#include "game_manager.cpp"
+#include "suggestions.cpp"
+#include "trie_manager.cpp"
+
+using namespace std;
+
+// Number of games played at the same time, 0 to play one for every
+// core
+int game_threads = 0;
+
+// Plays the turn of `player` like player_play() does, inserting the
+// best suggestion. The player passes if there is none. Returns true
+// if a word was inserted.
+bool
+play_best_suggestion(Game &game, Player &player)
+{
+    player.passed = false;
+    get_letters(game, player);
+
+    vector <Suggestion> best = get_suggestions(game.board, player, 1);
+    if (best.empty()
+        || !insert_word_to_board(Board_view(game.board, best[0].direction),
+                                 best[0].x, best[0].y, best[0].word, player)) {
+        player.passed = true;
+        return false;
+    }
+    return true;
+}
+
+// Plays a whole game between `names` like game_loop() does, with the
+// random numbers starting from `seed`
+Game_result
+simulate_game(vector <string> names, unsigned int seed)
+{
+    Game game;
+    Game_result result;
+    int player_turn = 0;
+    bool game_is_over = false;
+
+    game.seed = seed;
+    make_board(game);
+    make_bucket(game);
+    make_players(game, names);
+
+    result.moves = 0;
+    while (!game_is_over) {
+        if (play_best_suggestion(game, game.players.at(player_turn))) result.moves++;
+        player_turn = (player_turn + 1) % game.players.size();
+        game_is_over = is_game_over(game);
+    }
+
+    get_winner(game);           // Subtracts the letters left
+    result.winner = 0;
+    for (unsigned int i = 0; i < game.players.size(); i++) {
+        result.points.push_back(game.players[i].points);
+        if (result.points[i] > result.points[result.winner]) result.winner = i;
+    }
+    for (unsigned int i = 0; i < game.players.size(); i++)
+        if ((int) i != result.winner && result.points[i] == result.points[result.winner])
+            result.winner = -1; // Draw
+
+    destroy_board(game);
+    destroy_bucket(game);
+    destroy_players(game);
+    return result;
+}
+
+// Plays games until there are none left. Game `i` starts from seed
+// `seed` + `i`, so the results do not depend on which thread plays
+// it.
+void
+simulation_worker(vector <string> &names, unsigned int seed,
+                  vector <Game_result> &results, atomic <int> &next_game)
+{
+    int game;
+
+    while ((game = next_game++) < (int) results.size())
+        results[game] = simulate_game(names, seed + game);
+}
+
+// Plays `count` games without the tui, as many at the same time as
+// there are game threads. Prints the final scores of every game, the
+// engine throughput, the win rates and the score distribution of
+// every player.
+void
+simulate_games(int count, unsigned int seed, string dictionary_file, bool minimize)
+{
+    vector <string> names = {"CPU 1", "CPU 2"};
+    vector <Game_result> results(count);
+    atomic <int> next_game(0);
+    vector <thread> threads;
+
+    int workers = game_threads;
+    if (workers <= 0) workers = thread::hardware_concurrency();
+    workers = max(1, min(workers, count));
+    // Games are already played in parallel
+    if (workers > 1) suggestion_threads = 1;
+
+    make_dictionary(dictionary_file, minimize);
+    if (use_gaddag) make_gaddag();
+
+    auto start = chrono::steady_clock::now();
+    for (int i = 1; i < workers; i++)
+        threads.push_back(thread(simulation_worker, ref(names), seed,
+                                 ref(results), ref(next_game)));
+    simulation_worker(names, seed, results, next_game);
+    for (thread &t : threads) t.join();
+    double seconds = chrono::duration <double> (chrono::steady_clock::now() - start).count();
+
+    long total_moves = 0;
+    for (int game = 0; game < count; game++) {
+        Game_result &result = results[game];
+        total_moves += result.moves;
+
+        cout << "Game " << game + 1 << ":";
+        for (unsigned int i = 0; i < names.size(); i++)
+            cout << " " << names[i] << " " << result.points[i];
+        cout << ", winner " << ((result.winner < 0) ? "none" : names[result.winner]) << endl;
+    }
+
+    cout << "Games: " << count << " in " << seconds << " s, "
+         << workers << " at a time" << endl
+         << "Games/sec: " << count / seconds << endl
+         << "Moves/sec: " << total_moves / seconds << endl;
+
+    int draws = 0;
+    for (Game_result &result : results) draws += (result.winner < 0);
+    for (unsigned int i = 0; i < names.size(); i++) {
+        vector <int> points;
+        int wins = 0;
+        double sum = 0, square_sum = 0;
+
+        for (Game_result &result : results) {
+            points.push_back(result.points[i]);
+            wins += (result.winner == (int) i);
+            sum += result.points[i];
+            square_sum += (double) result.points[i] * result.points[i];
+        }
+        sort(points.begin(), points.end());
+        double mean = sum / count;
+
+        cout << names[i] << ": win rate " << 100.0 * wins / count << "%, score"
+             << " mean " << mean
+             << " stddev " << sqrt(max(0.0, square_sum / count - mean * mean))
+             << " min " << points.front()
+             << " median " << points[count / 2]
+             << " max " << points.back() << endl;
+    }
+    cout << "Draws: " << 100.0 * draws / count << "%" << endl;
+
+    destroy_suggestions_pool();
+    destroy_dictionary();
+    destroy_gaddag();
+}
+
+#endif
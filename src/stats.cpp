@@ -0,0 +1,154 @@
+// Instrumentation of the suggestions hot paths. When compiled with
+// UPWORDS_STATS defined (make STATS=1), every suggestions phase is
+// timed and counted. Otherwise the STATS_ macros expand to nothing.
+
+#ifndef STATS_CPP
+#define STATS_CPP
+
+// Includes
+#include <chrono>
+#include <fstream>
+#include <mutex>
+#include <vector>
+#include <string>
+
+using namespace std;
+
+// File where the statistics are written when the program exits
+#define STATS_FILE "upwords_stats.json"
+
+// Phases of a suggestions request. Time spent in a phase does not
+// include the time of the phases it calls.
+enum Stats_phase {
+    STATS_CROSS_CHECKS,         // Cross-checks of the board cache
+    STATS_ANCHORS,              // Anchors of the board cache and of rows
+    STATS_LEFT_PART,            // Left parts, before the anchor
+    STATS_RIGHT_PART,           // Right parts, from the anchor on
+    STATS_DEDUP,                // Ranking and removal of duplicates
+    STATS_PHASES
+};
+
+const char *stats_phase_names[STATS_PHASES] = {
+    "cross_checks", "anchors", "left_part", "right_part", "dedup"
+};
+
+#ifdef UPWORDS_STATS
+
+struct Stats {
+    double seconds[STATS_PHASES];
+    long calls[STATS_PHASES];   // Times every phase was entered
+    long nodes;                 // Dictionary nodes visited
+    long candidates;            // Words given to add_suggestion()
+    long requests;              // Calls of get_suggestions()
+    int phase;                  // Phase being timed, STATS_PHASES if none
+    chrono::steady_clock::time_point since; // When `phase` started
+};
+
+// Statistics of the requests done so far, and of the current thread
+Stats total_stats = {};
+mutex total_stats_mutex;
+thread_local Stats thread_stats = {{0}, {0}, 0, 0, 0, STATS_PHASES, {}};
+
+// Charges the time since the last switch to the current phase, and
+// starts timing `phase`
+void
+switch_stats_phase(Stats &stats, int phase)
+{
+    auto now = chrono::steady_clock::now();
+
+    if (stats.phase != STATS_PHASES)
+        stats.seconds[stats.phase] += chrono::duration <double> (now - stats.since).count();
+    if (phase != STATS_PHASES) stats.calls[phase]++;
+    stats.phase = phase;
+    stats.since = now;
+}
+
+// Times a phase until the end of the scope. Recursive calls in the
+// same phase do not read the clock.
+struct Stats_scope {
+    Stats &stats;
+    int previous;
+
+    Stats_scope(Stats &st, int phase) : stats(st), previous(st.phase) {
+        if (phase != previous) switch_stats_phase(stats, phase);
+    }
+    ~Stats_scope() {
+        if (stats.phase != previous) switch_stats_phase(stats, previous);
+    }
+};
+
+// Adds the statistics of the current thread to the total ones
+void
+flush_stats()
+{
+    lock_guard <mutex> lock(total_stats_mutex);
+
+    for (int i = 0; i < STATS_PHASES; i++) {
+        total_stats.seconds[i] += thread_stats.seconds[i];
+        total_stats.calls[i] += thread_stats.calls[i];
+        thread_stats.seconds[i] = 0;
+        thread_stats.calls[i] = 0;
+    }
+    total_stats.nodes += thread_stats.nodes;
+    total_stats.candidates += thread_stats.candidates;
+    total_stats.requests += thread_stats.requests;
+    thread_stats.nodes = thread_stats.candidates = thread_stats.requests = 0;
+}
+
+#define STATS_PHASE(phase) Stats_scope stats_scope(thread_stats, (phase))
+#define STATS_COUNT(counter, n) (thread_stats.counter += (n))
+#define STATS_FLUSH() flush_stats()
+
+#else
+
+#define STATS_PHASE(phase)
+#define STATS_COUNT(counter, n)
+#define STATS_FLUSH()
+
+#endif
+
+// Lines of the statistics overlay
+vector <string>
+get_stats_lines()
+{
+#ifdef UPWORDS_STATS
+    lock_guard <mutex> lock(total_stats_mutex);
+    vector <string> lines = {
+        "Requests: " + to_string(total_stats.requests),
+        "Nodes visited: " + to_string(total_stats.nodes),
+        "Candidates: " + to_string(total_stats.candidates)
+    };
+    for (int i = 0; i < STATS_PHASES; i++)
+        lines.push_back(string(stats_phase_names[i]) + ": "
+                        + to_string((long) (total_stats.seconds[i] * 1e6)) + " us, "
+                        + to_string(total_stats.calls[i]) + " calls");
+    return lines;
+#else
+    return {"Statistics are not compiled in.", "Build with make STATS=1"};
+#endif
+}
+
+// Writes the statistics to STATS_FILE as JSON. Meant to be called
+// when the program exits.
+void
+dump_stats()
+{
+#ifdef UPWORDS_STATS
+    lock_guard <mutex> lock(total_stats_mutex);
+    ofstream file(STATS_FILE);
+
+    file << "{\n"
+         << "  \"requests\": " << total_stats.requests << ",\n"
+         << "  \"nodes\": " << total_stats.nodes << ",\n"
+         << "  \"candidates\": " << total_stats.candidates << ",\n"
+         << "  \"phases\": {\n";
+    for (int i = 0; i < STATS_PHASES; i++)
+        file << "    \"" << stats_phase_names[i] << "\": {\"seconds\": "
+             << total_stats.seconds[i] << ", \"calls\": " << total_stats.calls[i]
+             << "}" << ((i < STATS_PHASES - 1) ? "," : "") << "\n";
+    file << "  }\n"
+         << "}\n";
+#endif
+}
+
+#endif
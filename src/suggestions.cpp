@@ -5,336 +5,758 @@
 
 // Includes
 #include <algorithm>
+#include <cstring>
 #include <map>
 #include <vector>
-#include <unordered_set>
 #include <string>
+#include <thread>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
 
 // Local includes
 #include "data_structs_n_constants.h"
 #include "game_manager.cpp"
+#include "stats.cpp"
 #include "trie_manager.cpp"
 
-int current_points;
-vector <string> suggestions;
-vector <Suggestion> suggestion_structs;
+// Number of threads that search suggestions, 0 to use one for every
+// core
+int suggestion_threads = 0;
 
-// This funciton gathers the cross-checks in a precise square on the
-// board
-vector <char>
-get_square_cross_checks(vector <vector <Letter>> &g_board, int x, int y)
+string
+make_suggestion(Suggestion const &sugg)
 {
-    Tnode *current;
-    vector <char> cross_checks;
-    string first_part;
-    string second_part;
+    // | d xx yy board_size pts |
+    // suggestion: d x y word pts
+    string direction = (sugg.direction == HORIZONTAL) ? ">" : "V";
+    string coords;
+    if (sugg.direction == HORIZONTAL)
+        coords = to_string(sugg.x+1) + " " + to_string(sugg.y+1);
+    else
+        coords = to_string(sugg.y+1) + " " + to_string(sugg.x+1);
+    string pts = to_string(sugg.points);
+    return direction + " " + coords + " " + sugg.word + " " + pts;
+}
 
-    // 3 cases: only up, only down, up and down
+// Formats suggestions for the suggestions window
+vector <string>
+format_suggestions(vector <Suggestion> const &suggs)
+{
+    vector <string> lines;
+    for (Suggestion const &sugg : suggs) lines.push_back(make_suggestion(sugg));
+    return lines;
+}
 
-    if ((y - 1) >= 0 && g_board.at(y - 1).at(x).letter != ' ')
-        first_part = get_downword(g_board, x, y - 1);
+// Order of suggestions with the same points, so that the ranking does
+// not depend on the generator or on which worker found them. Words
+// are compared like strings.
+bool
+compare_candidates(Candidate const &a, Candidate const &b)
+{
+    if (a.direction != b.direction) return a.direction > b.direction;
+    if (a.y != b.y) return a.y < b.y;
+    if (a.x != b.x) return a.x < b.x;
+    int cmp = memcmp(a.word, b.word, min(a.length, b.length));
+    if (cmp != 0) return cmp < 0;
+    return a.length < b.length;
+}
 
-    check_prefix(current, dictionary, first_part);
+// Returns true if suggestion `a` ranks before suggestion `b`
+bool
+better_candidate(Candidate const &a, Candidate const &b)
+{
+    if (a.points != b.points) return a.points > b.points;
+    return compare_candidates(a, b);
+}
 
-    if ((y + 1) < BOARD_SIZE && g_board.at(y + 1).at(x).letter != ' ')
-        second_part = get_downword(g_board, x, y + 1);
+bool
+same_candidate(Candidate const &a, Candidate const &b)
+{
+    return (a.direction == b.direction && a.y == b.y && a.x == b.x
+            && a.length == b.length && !memcmp(a.word, b.word, a.length));
+}
 
-    for (Tnode *e : current->Tchildren)
-        if (search_word(current, (e->letter + second_part)))
-            cross_checks.push_back(e->letter);
+// Returns true if the word in search `s` can be played, as long as
+// it is in the dictionary and fits the row: at least one letter comes
+// from the rack and not every letter is stacked. The generators check
+// everything else while they place the letters.
+inline bool
+is_legal_move(Search &s)
+{
+    return (s.placed > 0 && s.stacked < s.length);
+}
 
-    return cross_checks;
+// Points of a letter put from the rack on a square, and of a letter
+// stacked on another one, as score_word() counts them
+inline int
+placed_points(Search &s, int x)
+{
+    return s.cross_words[x] ? 3 : 2;
 }
 
-// Function to get all the cross-chekcs for each line (the int in the
-// map in the line)
-map <int, vector <char>>
-get_cross_checks(vector <vector <Letter>> &g_board, int y)
+inline int
+stacked_points(Search &s, int x)
 {
-    map <int, vector <char>> cross_checks;
+    return s.cross_words[x] ? 2 : 1;
+}
 
-    for (int x = 0; x < BOARD_SIZE; x++)
-        // if (g_board.at(y).at(x).letter == ' ' &&
-        if (check_updown_not_empty(g_board, x, y))
-            cross_checks[x] = get_square_cross_checks(g_board, x, y);
+// Points of board letter `letter` used as it is. score_word() gives
+// it a point only if the same letter is not left in the hand at that
+// point of the word, so the letters left of it must be placed already.
+inline int
+used_points(Search &s, char letter)
+{
+    return (s.rack.count[letter - 'A'] > 0) ? 0 : 1;
+}
+
+// Called by the generators for every legal move they find: the
+// `s.length` letters of `s.word`, starting at square `x` of row
+// `s.y`, worth `s.points` plus the bonus for using the whole hand.
+// The move is kept in the heap of search `s` if it is among its
+// `s.count` best ones so far. A move found twice is kept once.
+void
+add_suggestion(Search &s, int x)
+{
+    STATS_COUNT(candidates, 1);
+    STATS_PHASE(STATS_DEDUP);
+    Candidate cand;
+
+    cand.points = s.points + ((s.rack.mask == 0) ? 20 : 0);
+    memcpy(cand.word, s.word, s.length);
+    cand.length = s.length;
+    cand.x = x;
+    cand.y = s.y;
+    cand.direction = s.board.dir;
+
+    bool full = ((int) s.best.size() == s.count);
+    if (full && !better_candidate(cand, s.best.front())) return;
+    for (Candidate const &other : s.best)
+        if (same_candidate(cand, other)) return;
+
+    if (full) {
+        pop_heap(s.best.begin(), s.best.end(), better_candidate);
+        s.best.pop_back();
+    }
+    s.best.push_back(cand);
+    push_heap(s.best.begin(), s.best.end(), better_candidate);
+}
+
+// This funciton gathers the cross-checks in a precise square on the
+// board. Returns a mask with bit `i` set if letter 'A' + i can go on
+// the square. Squares without letters above or below accept every
+// letter.
+unsigned int
+get_square_cross_checks(Board_view g_board, int x, int y)
+{
+    const Tnode *current;
+    const Tnode *last_letter;
+    unsigned int cross_checks = 0;
+    char first_part[MAX_BOARD_SIZE];
+    char second_part[MAX_BOARD_SIZE];
+    int first_length = 0;
+    int second_length = 0;
+
+    if (!check_updown_not_empty(g_board, x, y)) return LETTERS_MASK;
+
+    // 3 cases: only up, only down, up and down. The square itself may
+    // hold a letter that we stack on, so both parts stop next to it.
+    unsigned int column = g_board.column(x);
+
+    for (int i = run_start(column, y); i < y; i++)
+        first_part[first_length++] = g_board.at(x, i).letter;
+
+    if (!check_prefix(current, dictionary, first_part, first_length)) return cross_checks;
+
+    for (int i = y + 1; i < run_end(column, y); i++)
+        second_part[second_length++] = g_board.at(x, i).letter;
+
+    const Tnode *child = first_child(current);
+    for (unsigned int m = current->mask & LETTERS_MASK; m; m &= m - 1, child++)
+        if (check_prefix(last_letter, child, second_part, second_length)
+            && is_end(last_letter))
+            cross_checks |= m & -m;
 
     return cross_checks;
 }
 
+// Function to get all the cross-chekcs for each line
+void
+get_cross_checks(Board_view g_board, int y, unsigned int cross_checks[])
+{
+    STATS_PHASE(STATS_CROSS_CHECKS);
+    for (int x = 0; x < BOARD_SIZE; x++)
+        cross_checks[x] = get_square_cross_checks(g_board, x, y);
+}
+
 // We assume that the row always contains elements Function to get the
 // anchors. Leftmost newly-covered square adjacent to a tile already
 // on the board is the anchor. Potential anchor squares: they are the
 // empty squares that are adjacent (vertically or horizontally) to
 // filled squares. Limit: the maximum size of the left part. This is
 // equal to the number of non-anchor squares to the left of the
-// current anchor square.
-map <int, int>
-get_anchors(vector <vector <Letter>> &g_board,
-            int y)
+// current anchor square, less the one that must stay empty before a
+// tile. `anchors` gets the limit of every square, -1 if it is not an
+// anchor.
+void
+get_anchors(Board_view g_board,
+            int y,
+            int anchors[])
 {
-    // coord, limit
+    STATS_PHASE(STATS_ANCHORS);
     int anch;
-    map <int, int> anchors;
 
-    if (first_turn && y == (anch = (BOARD_SIZE / 2))) {
+    for (int x = 0; x < BOARD_SIZE; x++) anchors[x] = -1;
+
+    if (g_board.board->first_turn && y == (anch = (BOARD_SIZE / 2))) {
         anchors[anch] = anch;
     } else {
-        if (g_board.at(y).at(0).letter != ' ') anchors[0] = 0;
-
-        for (int x = 1; x < BOARD_SIZE; x++) {
-            if (g_board.at(y).at(x).letter != ' ' && g_board.at(y).at(x - 1).letter == ' ') {
-                int limit = 1;
-                for (int j = x - 2;
-                     j >= 0 && (g_board.at(y).at(j).letter == ' ');
-                     // && !cross_checks.count(j);
-                     j--) {
-                    limit++;
-                }
-                anchors[x] = limit;
-            }
+        unsigned int row = g_board.row(y);
+
+        // The first letter of every run of letters
+        for (unsigned int m = row & ~(row << 1); m; m &= m - 1) {
+            int x = __builtin_ctz(m);
+            unsigned int before = row & ((1u << x) - 1);
+            // Empty squares since the last letter, or the board edge
+            int last = before ? 31 - __builtin_clz(before) : -1;
+            int limit = x - 1 - last;
+
+            if (last >= 0) limit--; // The left part can't touch a tile
+            anchors[x] = limit;
         }
     }
-    return anchors;
 }
 
+// Looks for every square of row `y` if a letter put there makes a
+// word across the row
 void
-extend_right_suggestion(vector <vector <Letter>> &g_board, int y, vector <char> &rack,
-                        int square, map <int, vector <char>> &cross_checks,
-                        bool dir, Tnode *dict, string partial_word);
+get_cross_words(Board_view g_board, int y, bool cross_words[])
+{
+    for (int x = 0; x < BOARD_SIZE; x++)
+        cross_words[x] = check_updown_not_empty(g_board, x, y);
+}
 
+// Recomputes the cross-checks and cross words of the squares of
+// column `x` whose vertical word goes through square (`x`, `y`): the
+// squares of the same run of letters and the empty squares right
+// above and below it.
 void
-find_next_letter_in_rack(vector <vector <Letter>> &g_board,
-                         int y,
-                         vector <char> &rack,
-                         int square,
-                         map <int, vector <char>> &cross_checks,
-                         bool dir,
-                         Tnode *dict,
-                         string &partial_word)
-{
-    // We try to reach the end
-    for (Tnode* current_node : dict->Tchildren) {
-        // We search each letter in our rack
-        auto it = find(rack.begin(), rack.end(), current_node->letter);
-        if (it != rack.end()) { // if rack is not empty
-            bool valid = true;  // to check if the cross-check is verified
-            if (cross_checks.count(square)) {
-                auto itc = find(cross_checks[square].begin(),
-                                cross_checks[square].end(), *it);
-                // if we find our letter *it in the cross-check for
-                // that square
-                if (itc == cross_checks[square].end()) valid = false;
+update_column_cross_checks(Board_view g_board,
+                           unsigned int cross_checks[][MAX_BOARD_SIZE],
+                           bool cross_words[][MAX_BOARD_SIZE],
+                           int x, int y)
+{
+    STATS_PHASE(STATS_CROSS_CHECKS);
+    unsigned int column = g_board.column(x);
+    int top = run_start(column, y) - 1;
+    int bottom = run_end(column, y);
+
+    for (int i = max(top, 0); i <= min(bottom, BOARD_SIZE - 1); i++) {
+        cross_checks[i][x] = get_square_cross_checks(g_board, x, i);
+        cross_words[i][x] = check_updown_not_empty(g_board, x, i);
+    }
+}
+
+// Brings the cache of board `g_board` up to date. Only the
+// cross-checks, cross words and anchors that depend on the touched squares are
+// recomputed, unless the cache is not valid yet or the first turn is
+// over, when everything is.
+void
+refresh_board_cache(Board &g_board)
+{
+    Board_cache &cache = g_board.cache;
+    bool full = (!cache.valid || cache.on_first_turn != g_board.first_turn);
+
+    for (bool dir : {HORIZONTAL, VERTICAL}) {
+        Board_view view(g_board, dir);
+
+        if (full) {
+            for (int y = 0; y < BOARD_SIZE; y++) {
+                get_cross_checks(view, y, cache.cross_checks[dir][y]);
+                get_cross_words(view, y, cache.cross_words[dir][y]);
+                get_anchors(view, y, cache.anchors[dir][y]);
             }
-            if (valid) {
-                char temp_c = *it;
-                rack.erase(it);
-                // we remove letter just checked so the recursion will
-                // not be considered in the next execution
-                extend_right_suggestion(g_board, y, rack, square + 1,
-                                        cross_checks, dir, current_node,
-                                        partial_word + temp_c);
-                rack.push_back(temp_c); // we put the letter back in
+        } else {
+            for (pair <int, int> const &square : cache.touched) {
+                int x = (dir == HORIZONTAL) ? square.first : square.second;
+                int y = (dir == HORIZONTAL) ? square.second : square.first;
+                update_column_cross_checks(view, cache.cross_checks[dir],
+                                           cache.cross_words[dir], x, y);
+                get_anchors(view, y, cache.anchors[dir][y]);
             }
         }
     }
+
+    cache.touched.clear();
+    cache.valid = true;
+    cache.on_first_turn = g_board.first_turn;
 }
 
 void
-extend_right_suggestion(vector <vector <Letter>> &g_board,
-                        int y,
-                        vector <char> &rack,
+extend_right_suggestion(Search &s, int square, const Tnode *dict);
+
+// Tries every rack letter that can go on `square`: on an empty
+// square, or stacked on a different letter under the layer limit.
+void
+find_next_letter_in_rack(Search &s,
+                         int square,
+                         const Tnode *dict)
+{
+    STATS_PHASE(STATS_RIGHT_PART);
+    Letter &board_letter = s.board.at(square, s.y);
+    bool stack = (board_letter.letter != ' ');
+    // We try to reach the end with every letter of our rack that has
+    // a child in the dictionary and passes the cross-check for that
+    // square
+    unsigned int m = dict->mask & s.rack.mask & s.cross_checks[square];
+    int points;
+
+    if (stack) {
+        if (board_letter.layer >= 5) return;
+        m &= ~letter_bit(board_letter.letter); // That is using it
+        points = stacked_points(s, square);
+    } else
+        points = placed_points(s, square);
+
+    for (; m; m &= m - 1) {
+        char temp_c = 'A' + __builtin_ctz(m);
+        // we remove letter just checked so the recursion will not
+        // be considered in the next execution
+        s.rack.take(temp_c);
+        s.word[s.length++] = temp_c;
+        s.points += points;
+        s.placed++;
+        s.stacked += stack;
+        extend_right_suggestion(s, square + 1, get_child(dict, temp_c));
+        s.stacked -= stack;
+        s.placed--;
+        s.points -= points;
+        s.length--;
+        s.rack.put_back(temp_c); // we put the letter back in
+    }
+}
+
+void
+extend_right_suggestion(Search &s,
                         int square,
-                        map <int, vector <char>> &cross_checks,
-                        bool dir,
-                        Tnode *dict,
-                        string partial_word)
+                        const Tnode *dict)
 {
+    STATS_PHASE(STATS_RIGHT_PART);
+    STATS_COUNT(nodes, 1);
     if (square >= BOARD_SIZE) return;
 
     char c_letter;
-    if (square >= BOARD_SIZE || (c_letter = g_board.at(y).at(square).letter) == ' ') {
-        if (dict->is_end) {     // If we already reached the end of
-                                // the tree, add to the passible
-                                // suggestions
-            suggestion_structs.push_back({partial_word, square - (int) partial_word.size(), y, dir});
-            // ( word, x, y, direction)
+    if (square >= BOARD_SIZE || (c_letter = s.board.at(square, s.y).letter) == ' ') {
+        if (is_end(dict) && is_legal_move(s)) {
+            // If we already reached the end of the tree, add to the
+            // passible suggestions
+            add_suggestion(s, square - s.length);
         }
 
-        find_next_letter_in_rack(g_board, y, rack, square,
-                                 cross_checks, dir, dict, partial_word);
+        find_next_letter_in_rack(s, square, dict);
     } else {
         // First case: normal attachment
-        auto it = find_if(dict->Tchildren.begin(),
-                          dict->Tchildren.end(),
-                          find_letter(c_letter));
-        if (it != dict->Tchildren.end())
-            extend_right_suggestion(g_board, y, rack, square + 1,
-                                    cross_checks, dir, *it,
-                                    partial_word + c_letter);
+        const Tnode *next = get_child(dict, c_letter);
+        if (next != nullptr) {
+            int points = used_points(s, c_letter);
+            s.word[s.length++] = c_letter;
+            s.points += points;
+            extend_right_suggestion(s, square + 1, next);
+            s.points -= points;
+            s.length--;
+        }
         // Second case: upword
-        find_next_letter_in_rack(g_board, y, rack, square,
-                                 cross_checks, dir, dict, partial_word);
+        find_next_letter_in_rack(s, square, dict);
+    }
+}
+
+// Scores the left part, the first `s.length` letters of `s.word`,
+// placed right before square `anchor`. Returns false if a letter does
+// not pass the cross-check of its square.
+bool
+score_left_part(Search &s, int anchor)
+{
+    int start = anchor - s.length;
+
+    s.points = 0;
+    for (int i = 0; i < s.length; i++) {
+        if (!(s.cross_checks[start + i] & letter_bit(s.word[i]))) return false;
+        s.points += placed_points(s, start + i);
     }
+    s.placed = s.length;
+    s.stacked = 0;
+    return true;
 }
 
 // This funciotn finds the lef tpart of a suggestion, and for each of
-// them, searches a right part
+// them, searches a right part. The left part is the first
+// `s.length` letters of `s.word`.
 void
-get_suggestions_for_anchor(vector <vector <Letter>> &g_board,
-                           int y,
-                           vector <char> &rack,
+get_suggestions_for_anchor(Search &s,
                            int anchor,
-                           map <int, vector <char>> &cross_checks,
-                           bool dir,
                            // Algorithm related
-                           Tnode *dict,
-                           string partial_word,
+                           const Tnode *dict,
                            int limit)
 {
-    extend_right_suggestion(g_board, y, rack, anchor, cross_checks, dir, dict, partial_word);
+    STATS_PHASE(STATS_LEFT_PART);
+    STATS_COUNT(nodes, 1);
+    if (score_left_part(s, anchor))
+        extend_right_suggestion(s, anchor, dict);
 
     if (limit > 0) {
-        for (Tnode* current_node : dict->Tchildren) {
-            char temp_c = '\0';
-            auto it = find(rack.begin(), rack.end(), current_node->letter);
-            if (it != rack.end()) {
-                temp_c = *it;
-                rack.erase(it);
-
-                get_suggestions_for_anchor(g_board, y, rack, anchor, cross_checks,
-                                           dir, current_node, partial_word + temp_c, limit - 1);
-                rack.push_back(temp_c);
-            }
+        for (unsigned int m = dict->mask & s.rack.mask; m; m &= m - 1) {
+            char temp_c = 'A' + __builtin_ctz(m);
+
+            s.rack.take(temp_c);
+            s.word[s.length++] = temp_c;
+            get_suggestions_for_anchor(s, anchor, get_child(dict, temp_c), limit - 1);
+            s.length--;
+            s.rack.put_back(temp_c);
         }
     }
 }
 
+// Searches the suggestions of row `s.y`, from every anchor of the row
 void
-get_suggestions_direction(vector <vector <Letter>> &g_board,
-                          vector <char> &rack,
-                          bool dir)
-{
-    for (int y = 0; y < BOARD_SIZE; y++) {
-        map <int, vector <char>> cross_checks = get_cross_checks(g_board, y);
-        map <int, int> anchors = get_anchors(g_board, y); // , cross_checks);
-        for (auto const &t : anchors) {
-            int anchor = t.first, limit = t.second;
-            get_suggestions_for_anchor(g_board, y, rack, anchor, cross_checks,
-                                       dir, dictionary, "", limit);
-        }
+get_suggestions_row(Search &s)
+{
+    STATS_PHASE(STATS_ANCHORS);
+    int *anchors = s.board.board->cache.anchors[s.board.dir][s.y];
+
+    for (int anchor = 0; anchor < BOARD_SIZE; anchor++)
+        if (anchors[anchor] >= 0)
+            get_suggestions_for_anchor(s, anchor, dictionary, anchors[anchor]);
+}
+
+// GADDAG move generator. Instead of building left parts from the
+// root of the dictionary, every move is grown from one of its anchor
+// squares: first leftwards, reading the GADDAG reversed part, then
+// rightwards after the separator. Here an anchor is any square a
+// move can connect through: an occupied square (used or stacked on)
+// or an empty square with a tile above or below. A move is generated
+// only from its leftmost anchor, so the left part never covers
+// another anchor square.
+
+// Use the GADDAG generator instead of the left part one
+bool use_gaddag = false;
+
+// Looks if a move can connect through square `x` of row `y`
+bool
+is_gaddag_anchor(Board_view g_board, int x, int y)
+{
+    if (g_board.board->first_turn) {
+        // Every square that satisfies check_first_turn()
+        int middle = BOARD_SIZE / 2;
+        bool even = (BOARD_SIZE % 2 == 0);
+        return ((y == middle || (even && y == middle - 1))
+                && (x == middle || (even && x == middle - 1)));
     }
+    return ((g_board.row(y) & (1u << x)) || check_updown_not_empty(g_board, x, y));
 }
 
+// Returns true if the word can end before `square`
 bool
-compare_by_direction(const Suggestion &a, const Suggestion &b)
+is_word_end(Board_view g_board, int y, int square)
 {
-    return (a.direction > b.direction);
+    return !(g_board.row(y) & (1u << square));
 }
 
-int
-get_points(vector <vector <Letter>> &g_board,
-           Suggestion &sugg,
-           Player &player,
-           int &pts)
-{
-    vector <vector <Letter>> temp_board(g_board);
-    Player temp_pl = player;
-    temp_pl.points = 0;
-
-    if (insert_word_to_board(temp_board, sugg.x, sugg.y, sugg.word, temp_pl)) {
-        pts = temp_pl.points;
-        return true;
-    } else {
-        pts = 0;
-        return false;
+void
+gaddag_extend(Search &s, int square, int anchor, int start, const Tnode *node);
+
+// Puts letter `letter` on `square` (from the board if `from_rack` is
+// false), follows it in the GADDAG and keeps growing the word in
+// `s.word`, which gets `points` more points. Letters left of the
+// anchor are collected in reverse.
+void
+gaddag_go_on(Search &s, int square, int anchor, int start,
+             const Tnode *node, char letter, bool from_rack, int points)
+{
+    const Tnode *next = get_child(node, letter);
+    if (next == nullptr) return;
+    STATS_COUNT(nodes, 1);
+    bool stack = (from_rack && s.board.at(square, s.y).letter != ' ');
+
+    if (from_rack) s.rack.take(letter);
+    s.word[s.length++] = letter;
+    s.points += points;
+    s.placed += from_rack;
+    s.stacked += stack;
+
+    if (square <= anchor) {     // Left part
+        gaddag_extend(s, square, anchor, square, next);
+    } else {                    // Right part
+        if (is_end(next) && is_word_end(s.board, s.y, square + 1) && is_legal_move(s))
+            add_suggestion(s, start);
+        gaddag_extend(s, square + 1, anchor, start, next);
     }
+
+    s.stacked -= stack;
+    s.placed -= from_rack;
+    s.points -= points;
+    s.length--;
+    if (from_rack) s.rack.put_back(letter);
 }
 
-string
-make_suggestion(Suggestion &sugg, int points)
+// Tries every letter that can go on `square`: the board letter, or
+// a rack letter that passes the cross-check, either on an empty
+// square or stacked on a different letter. Only the anchor square of
+// the left part can hold a letter, and the points of using it depend
+// on the letters left of it, so they are added at the separator.
+void
+gaddag_place(Search &s, int square, int anchor, int start, const Tnode *node)
 {
-    // | d xx yy board_size pts |
-    // suggestion: d x y word pts
-    string direction = (sugg.direction == HORIZONTAL) ? ">" : "V";
-    string coords;
-    if (sugg.direction == HORIZONTAL)
-        coords = to_string(sugg.x+1) + " " + to_string(sugg.y+1);
-    else
-        coords = to_string(sugg.y+1) + " " + to_string(sugg.x+1);
-    string pts = to_string(points);
-    return direction + " " + coords + " " + sugg.word + " " + pts;
+    STATS_PHASE((square <= anchor) ? STATS_LEFT_PART : STATS_RIGHT_PART);
+    Letter &board_letter = s.board.at(square, s.y);
+
+    unsigned int m = node->mask & s.rack.mask & s.cross_checks[square];
+    int points;
+
+    if (board_letter.letter != ' ') {
+        gaddag_go_on(s, square, anchor, start, node, board_letter.letter, false,
+                     (square > anchor) ? used_points(s, board_letter.letter) : 0);
+        if (board_letter.layer >= 5) return;
+        m &= ~letter_bit(board_letter.letter);
+        points = stacked_points(s, square);
+    } else
+        points = placed_points(s, square);
+
+    for (; m; m &= m - 1)
+        gaddag_go_on(s, square, anchor, start, node, 'A' + __builtin_ctz(m), true, points);
 }
 
+// Grows the word from GADDAG node `node`. While `square` is not after
+// the anchor, the left part has just reached `start` = `square`: the
+// word can either go on leftwards over a non anchor square, or turn
+// right after the separator.
 void
-add_suggestion(vector <vector <Letter>> &g_board,
-               Suggestion &sugg,
-               int &max_points,
-               Player &player)
-{
-    int current_pts;
-    if (get_points(g_board, sugg, player, current_pts)) {
-        if (current_pts > max_points) {
-            max_points = current_pts;
-            suggestions.clear();
-            suggestions.push_back(make_suggestion(sugg, current_pts));
-        } else if (current_pts == max_points) {
-            suggestions.push_back(make_suggestion(sugg, current_pts));
-        }
+gaddag_extend(Search &s, int square, int anchor, int start, const Tnode *node)
+{
+    STATS_PHASE((square <= anchor) ? STATS_LEFT_PART : STATS_RIGHT_PART);
+    if (square > anchor) {      // Right part
+        if (square < BOARD_SIZE)
+            gaddag_place(s, square, anchor, start, node);
+        return;
+    }
+
+    if (square > 0 && !is_gaddag_anchor(s.board, square - 1, s.y))
+        gaddag_place(s, square - 1, anchor, start, node);
+
+    const Tnode *separator = get_child(node, GADDAG_SEPARATOR);
+    if (separator != nullptr && (square == 0 || !(s.board.row(s.y) & (1u << (square - 1))))) {
+        // The anchor letter, first in `s.word`, may be the one on the
+        // board. Every rack letter of the left part is placed now.
+        char anchor_letter = s.board.at(anchor, s.y).letter;
+        int points = (s.word[0] == anchor_letter) ? used_points(s, anchor_letter) : 0;
+
+        // The left part is turned in place, and back once the right
+        // parts are done
+        reverse(s.word, s.word + s.length);
+        s.points += points;
+        if (is_end(separator) && is_word_end(s.board, s.y, anchor + 1) && is_legal_move(s))
+            add_suggestion(s, start);
+        gaddag_extend(s, anchor + 1, anchor, start, separator);
+        s.points -= points;
+        reverse(s.word, s.word + s.length);
     }
 }
 
-// Second version
+// Searches the suggestions of row `s.y` with the GADDAG
 void
-get_best_suggestions(vector <vector <Letter>> &g_board, Player &player)
+get_gaddag_suggestions_row(Search &s)
+{
+    STATS_PHASE(STATS_ANCHORS);
+
+    for (int anchor = 0; anchor < BOARD_SIZE; anchor++)
+        if (is_gaddag_anchor(s.board, anchor, s.y))
+            gaddag_place(s, anchor, anchor, anchor, gaddag);
+}
+
+// Searches rows until there are none left. The rows of the
+// HORIZONTAL view are numbered first, then the VERTICAL ones, and
+// `next_row` is shared by all the workers.
+void
+suggestions_worker(Search &s, atomic <int> &next_row)
+{
+    Board &g_board = *s.board.board;
+    int row;
+
+    s.best.reserve(s.count);
+    while ((row = next_row++) < 2 * BOARD_SIZE) {
+        bool dir = (row < BOARD_SIZE) ? HORIZONTAL : VERTICAL;
+        s.board = Board_view(g_board, dir);
+        s.y = row % BOARD_SIZE;
+        s.cross_checks = g_board.cache.cross_checks[dir][s.y];
+        s.cross_words = g_board.cache.cross_words[dir][s.y];
+
+        if (use_gaddag) get_gaddag_suggestions_row(s);
+        else get_suggestions_row(s);
+    }
+    STATS_FLUSH();
+}
+
+// Ranks together the suggestions of all the searches, and returns
+// the `count` best ones
+vector <Suggestion>
+merge_suggestions(vector <Search> &searches, int count)
 {
-    int max_pts = 0;
+    STATS_PHASE(STATS_DEDUP);
+    vector <Candidate> cands;
+    vector <Suggestion> best;
 
-    auto it_sugg = suggestion_structs.begin();
+    for (Search &s : searches)
+        cands.insert(cands.end(), s.best.begin(), s.best.end());
 
-    while (it_sugg != suggestion_structs.end()
-           && (*it_sugg).direction == HORIZONTAL) {
-        add_suggestion(g_board, *it_sugg, max_pts, player);
-        it_sugg++;
+    sort(cands.begin(), cands.end(), better_candidate);
+    cands.erase(unique(cands.begin(), cands.end(), same_candidate), cands.end());
+    if ((int) cands.size() > count) cands.resize(count);
+
+    for (Candidate &cand : cands)
+        best.push_back({string(cand.word, cand.length), cand.x, cand.y,
+                        cand.direction, cand.points});
+    return best;
+}
+
+// Pool of the workers that search suggestions with the calling
+// thread. They are started by the first request that needs them and
+// then wait for the next ones, searching the rows of `pool_searches`,
+// a search each.
+vector <thread> pool_threads;
+vector <Search> pool_searches;  // Kept between requests with their heaps
+mutex pool_mutex;
+mutex pool_request_mutex;       // One request at a time
+condition_variable pool_wake;   // A request was posted
+condition_variable pool_done;   // The workers finished a request
+atomic <int> pool_next_row(0);
+unsigned long pool_request = 0; // Number of the last request posted
+int pool_working = 0;           // Workers still searching it
+bool pool_stop = false;
+
+// Worker `index` of the pool. Workers without a search in the request
+// just wait for the next one.
+void
+pool_worker(unsigned int index)
+{
+    unsigned long request = 0;
+    unique_lock <mutex> lock(pool_mutex);
+
+    while (true) {
+        pool_wake.wait(lock, [&] { return pool_stop || pool_request != request; });
+        if (pool_stop) return;
+        request = pool_request;
+
+        lock.unlock();
+        if (index < pool_searches.size())
+            suggestions_worker(pool_searches[index], pool_next_row);
+        lock.lock();
+        if (--pool_working == 0) pool_done.notify_one();
     }
+}
 
-    transpose(g_board);
-    while (it_sugg != suggestion_structs.end()
-           && (*it_sugg).direction == VERTICAL) {
-        add_suggestion(g_board, *it_sugg, max_pts, player);
-        it_sugg++;
+// Searches the rows of all the `pool_searches` with the workers of the
+// pool, starting the missing ones. The calling thread searches the
+// first one.
+void
+run_pool()
+{
+    unique_lock <mutex> lock(pool_mutex);
+
+    while (pool_threads.size() + 1 < pool_searches.size())
+        pool_threads.push_back(thread(pool_worker, pool_threads.size() + 1));
+    pool_next_row = 0;
+    pool_working = pool_threads.size();
+    pool_request++;
+    lock.unlock();
+    pool_wake.notify_all();
+
+    suggestions_worker(pool_searches[0], pool_next_row);
+
+    lock.lock();
+    pool_done.wait(lock, [] { return pool_working == 0; });
+}
+
+// Stops the workers of the pool
+void
+destroy_suggestions_pool()
+{
+    {
+        lock_guard <mutex> lock(pool_mutex);
+        pool_stop = true;
     }
-    transpose(g_board);
-    return;
+    pool_wake.notify_all();
+    for (thread &t : pool_threads) t.join();
+
+    pool_threads.clear();
+    pool_searches.clear();
+    pool_stop = false;
 }
 
+// Makes `s` a new search of `count` suggestions, keeping the memory
+// of its heap
 void
-uniquify_suggestions()
+reset_search(Search &s, Board &g_board, vector <char> &letters, int count)
 {
-    unordered_set <string> temp_set;
-    for (string sugg : suggestions) temp_set.insert(sugg);
-    suggestions.assign(temp_set.begin(), temp_set.end());
+    Search fresh(g_board, letters, count);
+
+    fresh.best.swap(s.best);
+    fresh.best.clear();
+    s = move(fresh);
 }
 
-// Main function that returns suggestions for a given board and a
-// given player
-vector <string>
-get_suggestions(vector <vector <Letter>> &g_board,
-                Player &player)
+// Returns the number of threads that search a request: one if the
+// board has few anchors or the rack few letters, else all of them
+int
+request_workers(Board &g_board, Player &player)
 {
-    vector <char> temp_rack = player.letters;
-    suggestions.clear();
-    suggestion_structs.clear();
+    int workers = suggestion_threads;
+    int anchors = 0;
+
+    if (workers <= 0) workers = thread::hardware_concurrency();
+    workers = max(1, min(workers, 2 * BOARD_SIZE));
+    if (workers == 1 || (int) player.letters.size() < PARALLEL_MIN_LETTERS)
+        return 1;
+
+    for (bool dir : {HORIZONTAL, VERTICAL})
+        for (int y = 0; y < BOARD_SIZE; y++)
+            for (int x = 0; x < BOARD_SIZE; x++)
+                anchors += (g_board.cache.anchors[dir][y][x] >= 0);
+    return (anchors < PARALLEL_MIN_ANCHORS) ? 1 : workers;
+}
 
-    get_suggestions_direction(g_board, temp_rack, HORIZONTAL);
+// Main function that returns the `count` best suggestions for a
+// given board and a given player, best first. Big requests share the
+// rows of both directions among the workers of the pool, every one
+// with its own search, then the suggestions of all the searches are
+// ranked together. Small ones are searched on the calling thread.
+vector <Suggestion>
+get_suggestions(Board &g_board,
+                Player &player,
+                int count)
+{
+    vector <Suggestion> best;
+
+    if (count <= 0) return {};
+    refresh_board_cache(g_board);
 
-    transpose(g_board);
-    get_suggestions_direction(g_board, temp_rack, VERTICAL);
-    transpose(g_board);
+    int workers = request_workers(g_board, player);
+    if (workers > 1) {
+        lock_guard <mutex> request(pool_request_mutex);
 
-    get_best_suggestions(g_board, player);
+        pool_searches.resize(workers, Search(g_board, player.letters, count));
+        for (Search &s : pool_searches)
+            reset_search(s, g_board, player.letters, count);
+        run_pool();
+        best = merge_suggestions(pool_searches, count);
+    } else {
+        vector <Search> searches(1, Search(g_board, player.letters, count));
+        atomic <int> next_row(0);
 
-    uniquify_suggestions();
-    return suggestions;
+        suggestions_worker(searches[0], next_row);
+        best = merge_suggestions(searches, count);
+    }
+    STATS_COUNT(requests, 1);
+    STATS_FLUSH();
+    return best;
 }
 
 #endif
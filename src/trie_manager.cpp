@@ -5,172 +5,684 @@
 
 // Includes
 #include <algorithm>
+#include <cstdio>
+#include <cstring>
 #include <fstream>
+#include <map>
 #include <string>
+#include <thread>
 #include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 // Local includes
 #include "data_structs_n_constants.h"
 
 using namespace std;
 
-Tnode *dictionary;
+// Number of threads building the dictionary, 0 to use one for every
+// core
+int loader_threads = 0;
 
-// Function used in sort() to compare node letters
-bool
-trie_cmp(const Tnode* a, const Tnode* b)
-{
-    return a->letter < b->letter;
-}
-
-// This struct is used to create lexical closures. We initialize a
-// struct with a certain letter and save it to `l` field. This struct
-// has an operator `()` overloaded. This acts like a
-// function: it takes some value as an argument, and compare it to the
-// `l` field in struct.
-struct find_letter {
-    char l;
-    find_letter(char letter) : l(letter) {}
-    bool operator () ( const Tnode *m ) const
-        {
-            return m->letter == l;
-        }
-};
+// Flat dictionary. `dictionary` points to the root node inside
+// `dictionary_nodes`.
+vector <Tnode> dictionary_nodes;
+const Tnode *dictionary;
+
+// Returns the mask bit of a letter
+inline unsigned int
+letter_bit(char letter)
+{
+    return 1u << (letter - 'A');
+}
+
+// Returns true if the node ends a word
+inline bool
+is_end(const Tnode *node)
+{
+    return node->mask & END_OF_WORD;
+}
+
+// Returns the first child of a node. The other children follow it in
+// letter order.
+inline const Tnode*
+first_child(const Tnode *node)
+{
+    return node + node->children;
+}
+
+// Given a node and a letter, returns the child node of that letter,
+// or nullptr if there is none.
+inline const Tnode*
+get_child(const Tnode *node, char letter)
+{
+    unsigned int bit = letter_bit(letter);
+
+    if (!(node->mask & bit)) return nullptr;
+    return first_child(node) + __builtin_popcount(node->mask & (bit - 1));
+}
 
+// Follows the `length` letters of `prefix` from node `root`. If they
+// are all there, `last_letter` gets the node of the last one and true
+// is returned. The letters must be uppercase already: nothing is
+// copied, and anything else is not found.
 bool
-check_prefix(Tnode *&last_letter, Tnode *root, string prefix)
+check_prefix(const Tnode *&last_letter, const Tnode *root,
+             const char *prefix, int length)
 {
-    Tnode *current = root;
+    const Tnode *current = root;
 
-    for (char letter : prefix) {
-        vector <Tnode*>::iterator it = find_if(current->Tchildren.begin(),
-                                               current->Tchildren.end(),
-                                               find_letter(letter));
-        if (it == current->Tchildren.end()) return false;
-        current = *it;
+    for (int i = 0; i < length; i++) {
+        if (prefix[i] < 'A' || prefix[i] > 'Z') return false;
+        current = get_child(current, prefix[i]);
+        if (current == nullptr) return false;
     }
     last_letter = current;
     return true;
 }
 
+bool
+check_prefix(const Tnode *&last_letter, const Tnode *root, const string &prefix)
+{
+    return check_prefix(last_letter, root, prefix.data(), prefix.size());
+}
+
+// Same as search_word() below, for the `length` letters of `word`.
+// They must be uppercase already, so nothing is copied.
+bool
+search_word(const Tnode *root, const char *word, int length)
+{
+    const Tnode *last_letter;
+
+    return (check_prefix(last_letter, root, word, length) && is_end(last_letter));
+}
 
-// Given a trie root and a word `str`, check if trie contains the word `str`
+// Given a trie root and a word `str`, check if trie contains the word
+// `str`, in any case
 bool
-search_word(Tnode *root, string str)
+search_word(const Tnode *root, string str)
 {
     transform(str.begin(), str.end(), str.begin(), ::toupper); // Upcase string
-    Tnode *last_letter;
 
-    if (check_prefix(last_letter, root, str))
-        return last_letter->is_end;
-    else
-        return false;
+    return search_word(root, str.data(), str.size());
 }
 
-// Given a trie root, deletes it from memory, forever :(
+// Trie builder
+
+// Returns a new trie node for letter `letter`, taken from `arena`.
+// A new block is allocated only when the last one is full.
+Bnode*
+new_bnode(Trie_arena &arena, char letter)
+{
+    unsigned int block = arena.used / TRIE_ARENA_BLOCK;
+
+    if (block == arena.blocks.size())
+        arena.blocks.push_back(new Bnode[TRIE_ARENA_BLOCK]);
+
+    Bnode *node = &arena.blocks[block][arena.used++ % TRIE_ARENA_BLOCK];
+    node->letter = letter;
+    node->is_end = false;
+    node->child = nullptr;
+    node->next = nullptr;
+    return node;
+}
+
+// Forgets every node of `arena`, keeping its blocks for the next
+// trie
 void
-delete_trie(Tnode *&root) {
-    if (root == nullptr) return;
-    for (Tnode* child : root->Tchildren) {
-        delete_trie(child);
-    }
-    root->Tchildren.clear();
-    delete root;
-    root = nullptr;
-    return;
+reset_arena(Trie_arena &arena)
+{
+    arena.used = 0;
+}
+
+// Frees every node of `arena`, so every trie built in it, at once
+void
+destroy_arena(Trie_arena &arena)
+{
+    for (Bnode *block : arena.blocks)
+        delete[] block;
+    arena.blocks.clear();
+    arena.used = 0;
+}
+
+// Moves the blocks of arena `part` to `arena`, which then owns their
+// nodes. New nodes of `arena` are taken from a new block.
+void
+merge_arena(Trie_arena &arena, Trie_arena &part)
+{
+    arena.blocks.insert(arena.blocks.end(), part.blocks.begin(), part.blocks.end());
+    arena.used = arena.blocks.size() * TRIE_ARENA_BLOCK;
+    part.blocks.clear();
+    part.used = 0;
 }
 
 // Given a trie node and a letter, check if the letter exists in a
 // node. If the letter exists, return letter node. Otherwise, create
 // new node with a letter, insert it into the trie, and return it.
-Tnode*
-insert_char(Tnode *node, char letter)
-{
-    // Check in the letter is in the node children.
-    vector<Tnode*>::iterator found_val = find_if(node->Tchildren.begin(),
-                                                 node->Tchildren.end(),
-                                                 find_letter(letter));
-
-    if (found_val == node->Tchildren.end()) { // If letter is not in the node children
-        Tnode *new_letter = new Tnode;        // Create new node with given letter
-        new_letter->letter = letter;
-        new_letter->is_end = false;
-        // new_letter->Tchildren = {};
-
-        vector<Tnode*>::iterator iter = node->Tchildren.begin();
-        vector<Tnode*>::iterator end = node->Tchildren.end();
-        int size = node->Tchildren.size();
-
-        // Sorted insertion
-        while (size != 0
-               && iter != end
-               && new_letter->letter < (*iter)->letter)
-            iter++;
-
-        if (iter == end)
-            node->Tchildren.push_back(new_letter);
-        else
-            node->Tchildren.insert(iter, new_letter);
+Bnode*
+insert_char(Trie_arena &arena, Bnode *node, char letter)
+{
+    Bnode **link = &node->child;
+
+    // Sorted search: stop at the letter or where it should be
+    while (*link != nullptr && (*link)->letter < letter)
+        link = &(*link)->next;
+
+    if (*link == nullptr || (*link)->letter != letter) { // If letter is not in the node children
+        Bnode *new_letter = new_bnode(arena, letter);    // Create new node with given letter
+        new_letter->next = *link;
+        *link = new_letter;
+    }
+    return *link;
+}
+
+// Given a trie node and an upcase word, insert the word below the
+// node
+void
+insert_word(Trie_arena &arena, Bnode *node, const char *word)
+{
+    for (; *word != '\0'; word++)
+        node = insert_char(arena, node, *word);
+    node->is_end = true;
+    return;
+}
+
+// Writes the children of trie node `node` as one block at the end of
+// `nodes`, links them to the already written flat node at `index`
+// and then does the same for every child. Blocks are written before
+// the blocks of their children, so a lookup always walks forward in
+// memory.
+void
+flatten_node(Bnode *node, vector <Tnode> &nodes, unsigned int index)
+{
+    unsigned int block = nodes.size();
+
+    nodes[index].mask = node->is_end ? END_OF_WORD : 0;
+    nodes[index].children = block - index;
+
+    for (Bnode *child = node->child; child != nullptr; child = child->next) {
+        nodes[index].mask |= letter_bit(child->letter);
+        nodes.push_back({0, 0});
+    }
+    unsigned int i = block;
+    for (Bnode *child = node->child; child != nullptr; child = child->next)
+        flatten_node(child, nodes, i++);
+}
+
+// Function used by map to compare children blocks
+bool
+operator < (const Tnode &a, const Tnode &b)
+{
+    return (a.mask < b.mask || (a.mask == b.mask && a.children < b.children));
+}
+
+// Returns the flat node of trie node `node`, with `children` holding
+// the absolute position of its children block. The block is appended
+// to `nodes` only if an identical one was not written before. Children
+// are minimized before their parents, so two equal blocks always
+// stand for two equal sets of suffixes, and the trie becomes a
+// directed acyclic word graph.
+Tnode
+minimize_node(Bnode *node, vector <Tnode> &nodes, map <vector <Tnode>, int> &blocks)
+{
+    vector <Tnode> block;
+    Tnode flat = {0, node->is_end ? END_OF_WORD : 0};
+
+    for (Bnode *child = node->child; child != nullptr; child = child->next) {
+        block.push_back(minimize_node(child, nodes, blocks));
+        flat.mask |= letter_bit(child->letter);
+    }
 
-        // Maybe we will need it in the future. :)
-        // node->Tchildren.push_back(new_letter); // Push new node to trie
-        // sort(node->Tchildren.begin(), node->Tchildren.end(), trie_cmp); // Sort nodes
-        return new_letter;
-    } else                      // Otherwise return found node
-        return *found_val;
+    if (!block.empty()) {
+        map <vector <Tnode>, int>::iterator found = blocks.find(block);
+        if (found == blocks.end()) {
+            found = blocks.insert({block, (int) nodes.size()}).first;
+            nodes.insert(nodes.end(), block.begin(), block.end());
+        }
+        flat.children = found->second;
+    }
+    return flat;
 }
 
-// Given a trie root and a word, insert word in the trie.
+// Turns the absolute block positions left by minimize_node() into
+// relative offsets
 void
-insert_word(Tnode *root, string word)
+make_offsets_relative(vector <Tnode> &nodes)
+{
+    for (unsigned int i = 0; i < nodes.size(); i++)
+        if (nodes.at(i).mask & ~END_OF_WORD)
+            nodes.at(i).children -= i;
+}
+
+// Given a trie root, returns its flat version. The root is the first
+// node. If `minimize` is true, identical suffix subtrees are merged.
+vector <Tnode>
+flatten_trie(Bnode *root, bool minimize)
 {
-    transform(word.begin(), word.end(), word.begin(), ::toupper); // Upcase string
-    Tnode *current_node = root;
+    vector <Tnode> nodes(1, {0, 0});
 
-    bool is_ascii = true;
-    for (char letter : word)
-        is_ascii = (is_ascii && ('A' <= letter && letter <= 'Z'));
+    if (minimize) {
+        map <vector <Tnode>, int> blocks;
+        Tnode flat_root = minimize_node(root, nodes, blocks);
+        nodes.at(0) = flat_root;
+        make_offsets_relative(nodes);
+    } else
+        flatten_node(root, nodes, 0);
 
-    if (is_ascii) {
-        for (char letter : word) {
-            current_node = insert_char(current_node, letter);
+    nodes.shrink_to_fit();
+    return nodes;
+}
+
+// Given a trie node without children and sorted upcase words, insert
+// the words below the node, skipping their first letter. A word
+// shares a prefix with the previous one, so only the nodes of that
+// prefix can get new children, always after the ones they have. They
+// are kept in `open`, and every letter is appended without searching.
+void
+insert_sorted_words(Trie_arena &arena, Bnode *root, vector <const char*> &words)
+{
+    vector <Bnode*> open(1, root); // Nodes of the letters of the last word
+    const char *last = "";
+
+    for (const char *word : words) {
+        word++;
+        unsigned int common = 0;
+        while (word[common] != '\0' && word[common] == last[common])
+            common++;
+
+        // Last child of the node where the new letters start
+        Bnode *sibling = (common + 1 < open.size()) ? open[common + 1] : nullptr;
+        open.resize(common + 1);
+
+        for (const char *letter = word + common; *letter != '\0'; letter++) {
+            Bnode *node = new_bnode(arena, *letter);
+            if (sibling != nullptr) sibling->next = node;
+            else open.back()->child = node;
+            sibling = nullptr;
+            open.push_back(node);
         }
-        current_node->is_end = true;
+        open.back()->is_end = true;
+        last = word;
+    }
+}
+
+// Builds the subtries of the words starting with letters `first` to
+// `last` - 1. `words[i]` holds the words starting with letter 'A' +
+// i, and the subtrie of the letter is stored in `roots[i]`. Sorted
+// word lists, as most dictionary files are, are appended with
+// insert_sorted_words().
+void
+build_subtries(Trie_arena &arena, vector <const char*> *words,
+               int first, int last, Bnode **roots)
+{
+    for (int i = first; i < last; i++) {
+        if (words[i].empty()) continue;
+        roots[i] = new_bnode(arena, 'A' + i);
+
+        if (is_sorted(words[i].begin(), words[i].end(),
+                      [](const char *a, const char *b) { return strcmp(a, b) < 0; }))
+            insert_sorted_words(arena, roots[i], words[i]);
+        else
+            for (const char *word : words[i])
+                insert_word(arena, roots[i], word + 1);
     }
-    return;
 }
 
 // Given a string containing dictionary filename, for every line
-// (word) in a dictionary add word to trie.
-Tnode*
-create_trie(string filename)
-{
-    string word;
-    Tnode *root = new Tnode;
-    root->is_end = false;
-    ifstream dict(filename); // Create input file stream
-
-    if (dict.is_open()) { // If we can read from it
-        while (getline(dict, word)) { // read line (word)
-            if (word.size() <= (unsigned int) BOARD_SIZE) {
-                insert_word(root, word); // insert line (word) into trie
-            }
+// (word) in a dictionary add word to trie. Words longer than
+// `max_length` are skipped. The nodes are taken from `arena`.
+// Returns nullptr if the file can't be read.
+//
+// The file is read at once and its words are split by first letter.
+// The letters are shared in ranges with about the same number of
+// words among the loader threads, every one building the subtries of
+// its letters in its own arena. The subtries are then attached to the
+// root.
+Bnode*
+create_trie(Trie_arena &arena, string filename, int max_length)
+{
+    Bnode *root = new_bnode(arena, '\0');
+    ifstream dict(filename, ios::binary); // Create input file stream
+    string buffer;
+
+    if (!dict.is_open()) return nullptr;
+    dict.seekg(0, ios::end);
+    buffer.resize((size_t) max((streamoff) 0, (streamoff) dict.tellg()));
+    dict.seekg(0, ios::beg);
+    if (!dict.read(&buffer[0], buffer.size())) return nullptr;
+    if (!buffer.empty() && buffer.back() != '\n') buffer.push_back('\n');
+
+    // Every line becomes an upcase C string inside `buffer`
+    vector <const char*> words[26];
+    int word_count = 0;
+    for (size_t start = 0, end; start < buffer.size(); start = end + 1) {
+        end = buffer.find('\n', start);
+        bool is_ascii = (end - start <= (size_t) max_length);
+
+        for (size_t i = start; is_ascii && i < end; i++) {
+            buffer[i] = toupper((unsigned char) buffer[i]);
+            is_ascii = ('A' <= buffer[i] && buffer[i] <= 'Z');
+        }
+        buffer[end] = '\0';
+
+        if (!is_ascii) continue;
+        if (end == start) {
+            root->is_end = true;
+        } else {
+            words[buffer[start] - 'A'].push_back(&buffer[start]);
+            word_count++;
         }
     }
+
+    int workers = loader_threads;
+    if (workers <= 0) workers = thread::hardware_concurrency();
+    workers = max(1, min(workers, 26));
+
+    Bnode *roots[26] = {nullptr};
+    vector <Trie_arena> arenas(workers);
+    vector <thread> threads;
+    int first = 0, words_before = 0;
+
+    for (int w = 0; w < workers; w++) {
+        int last = first;
+        while (last < 26 && (w == workers - 1
+                             || (long) words_before * workers < (long) word_count * (w + 1)))
+            words_before += words[last++].size();
+
+        if (w == workers - 1)   // The calling thread is a worker too
+            build_subtries(arenas[w], words, first, last, roots);
+        else
+            threads.push_back(thread(build_subtries, ref(arenas[w]), words,
+                                     first, last, roots));
+        first = last;
+    }
+    for (thread &t : threads) t.join();
+
+    Bnode **link = &root->child;
+    for (int i = 0; i < 26; i++)
+        if (roots[i] != nullptr) {
+            *link = roots[i];
+            link = &roots[i]->next;
+        }
+    for (Trie_arena &part : arenas) merge_arena(arena, part);
     return root;
 }
 
+// Compiled dictionary
+
+// Reads the header of file `filename`. Returns true if the file is a
+// compiled dictionary.
+bool
+read_dictionary_header(string filename, Dictionary_header &header)
+{
+    ifstream dict(filename, ios::binary);
+
+    return (dict.read((char *) &header, sizeof(header))
+            && header.magic == DICTIONARY_MAGIC);
+}
+
+// Given a text dictionary `filename`, writes its minimized flat
+// version to file `output`, so that it can be loaded later without
+// parsing. Words are kept up to the biggest board size, so the same
+// file works for every board. The file is written next to `output`
+// and renamed over it, so games that have the old one mapped keep
+// it. Returns false if `filename` can't be read or the file can't be
+// written.
+bool
+compile_dictionary(string filename, string output)
+{
+    Trie_arena arena;
+    Bnode *root = create_trie(arena, filename, MAX_BOARD_SIZE);
+    if (root == nullptr) {
+        destroy_arena(arena);
+        return false;
+    }
+    vector <Tnode> nodes = flatten_trie(root, true);
+    destroy_arena(arena);
+
+    Dictionary_header header = {DICTIONARY_MAGIC, DICTIONARY_VERSION,
+                                MAX_BOARD_SIZE, (unsigned int) nodes.size()};
+    string temporary = output + "." + to_string(getpid()) + ".tmp";
+    ofstream dict(temporary, ios::binary | ios::trunc);
+
+    dict.write((char *) &header, sizeof(header));
+    dict.write((char *) nodes.data(), nodes.size() * sizeof(Tnode));
+    dict.close();
+
+    if (!dict.good() || rename(temporary.c_str(), output.c_str()) != 0) {
+        remove(temporary.c_str());
+        return false;
+    }
+    return true;
+}
+
+// Returns true if the children of every node in `nodes` lie inside
+// them, so that a broken file can't make lookups read past the end
+bool
+check_dictionary(const Tnode *nodes, unsigned int size)
+{
+    for (unsigned int i = 0; i < size; i++) {
+        unsigned int mask = nodes[i].mask & ~END_OF_WORD;
+        long long first = (long long) i + nodes[i].children;
+
+        if (mask && (first < 0 || first + __builtin_popcount(mask) > size))
+            return false;
+    }
+    return true;
+}
+
+// Memory mapping of the loaded compiled dictionary
+void *dictionary_map = nullptr;
+size_t dictionary_map_size = 0;
+
+// Maps compiled dictionary `filename` into memory and uses it
+// directly as the dictionary. The pages are read-only, so processes
+// using the same file share them. Returns false if the file is not a
+// valid compiled dictionary.
+bool
+map_dictionary(string filename)
+{
+    Dictionary_header header;
+    struct stat file_stat;
+    int fd;
+
+    if (!read_dictionary_header(filename, header)
+        || header.version != DICTIONARY_VERSION
+        || header.max_length < (unsigned int) BOARD_SIZE
+        || header.size == 0)
+        return false;
+
+    if ((fd = open(filename.c_str(), O_RDONLY)) < 0) return false;
+    if (fstat(fd, &file_stat) < 0
+        || (size_t) file_stat.st_size != sizeof(header) + header.size * sizeof(Tnode)) {
+        close(fd);
+        return false;
+    }
+
+    dictionary_map_size = file_stat.st_size;
+    dictionary_map = mmap(nullptr, dictionary_map_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);              // The mapping stays valid
+
+    if (dictionary_map == MAP_FAILED) {
+        dictionary_map = nullptr;
+        return false;
+    }
+    dictionary = (const Tnode *) ((char *) dictionary_map + sizeof(header));
+    if (!check_dictionary(dictionary, header.size)) {
+        munmap(dictionary_map, dictionary_map_size);
+        dictionary_map = nullptr;
+        dictionary_map_size = 0;
+        dictionary = nullptr;
+        return false;
+    }
+    return true;
+}
+
+// Loads the dictionary from file `filename`, which is either a
+// compiled dictionary or a text file with a word per line. If
+// `minimize` is true, a text dictionary is stored as a word graph,
+// which takes much less memory.
+void
+make_dictionary(string filename, bool minimize = false)
+{
+    Dictionary_header header;
+
+    if (read_dictionary_header(filename, header)) {
+        if (!map_dictionary(filename)) { // Wrong version or broken file
+            dictionary_nodes.assign(1, {0, 0});
+            dictionary = dictionary_nodes.data();
+        }
+        return;
+    }
+
+    Trie_arena arena;
+    Bnode *root = create_trie(arena, filename, BOARD_SIZE);
+    if (root == nullptr) dictionary_nodes.assign(1, {0, 0}); // No words
+    else dictionary_nodes = flatten_trie(root, minimize);
+    dictionary = dictionary_nodes.data();
+    destroy_arena(arena);
+    return;
+}
+
+// GADDAG
+
+// Flat GADDAG of the dictionary. `gaddag` points to its root.
+vector <Tnode> gaddag_nodes;
+const Tnode *gaddag;
+
+// Appends to `words` every word below flat dictionary node `node`
+// that is not longer than `max_length`. `prefix` contains the letters
+// that lead to `node`.
+void
+collect_words(const Tnode *node, string &prefix, int max_length,
+              vector <string> &words)
+{
+    if (is_end(node)) words.push_back(prefix);
+    if ((int) prefix.size() >= max_length) return;
+
+    const Tnode *child = first_child(node);
+    for (unsigned int m = node->mask & LETTERS_MASK; m; m &= m - 1, child++) {
+        prefix.push_back('A' + __builtin_ctz(m));
+        collect_words(child, prefix, max_length, words);
+        prefix.pop_back();
+    }
+}
+
+// Inserts in the trie `root` the GADDAG path of `word` split after
+// `split` letters: the first `split` letters reversed, the separator
+// and the rest of the word. The first letter of the path is the
+// letter of `root` itself.
+void
+insert_gaddag_path(Trie_arena &arena, Bnode *root, string &word, int split)
+{
+    Bnode *current_node = root;
+
+    for (int i = split - 2; i >= 0; i--)
+        current_node = insert_char(arena, current_node, word.at(i));
+    current_node = insert_char(arena, current_node, GADDAG_SEPARATOR);
+    for (unsigned int i = split; i < word.size(); i++)
+        current_node = insert_char(arena, current_node, word.at(i));
+    current_node->is_end = true;
+}
+
+// Builds the GADDAG of the loaded dictionary. Every word is stored
+// once for every split point, so a word can be grown in both
+// directions starting from any of its letters. The paths are built
+// one starting letter at a time and always minimized: the plain trie
+// would be many times bigger than the dictionary. Every starting
+// letter reuses the nodes of the previous one.
 void
-make_dictionary(string filename)
+make_gaddag()
 {
-    dictionary = create_trie(filename);
+    Trie_arena arena;
+    vector <string> words;
+    string prefix;
+    map <vector <Tnode>, int> blocks;
+    vector <Tnode> root_block;
+    unsigned int root_mask = 0;
+
+    collect_words(dictionary, prefix, BOARD_SIZE, words);
+    gaddag_nodes.assign(1, {0, 0});
+
+    for (char letter = 'A'; letter <= 'Z'; letter++) {
+        reset_arena(arena);
+        Bnode *root = new_bnode(arena, letter);
+
+        for (string &word : words)
+            for (unsigned int i = 1; i <= word.size(); i++)
+                if (word.at(i - 1) == letter)
+                    insert_gaddag_path(arena, root, word, i);
+
+        if (root->child != nullptr) {
+            root_block.push_back(minimize_node(root, gaddag_nodes, blocks));
+            root_mask |= letter_bit(letter);
+        }
+    }
+    destroy_arena(arena);
+
+    gaddag_nodes.at(0) = {(int) gaddag_nodes.size(), root_mask};
+    gaddag_nodes.insert(gaddag_nodes.end(), root_block.begin(), root_block.end());
+    make_offsets_relative(gaddag_nodes);
+    gaddag_nodes.shrink_to_fit();
+    gaddag = gaddag_nodes.data();
+    return;
+}
+
+void
+destroy_gaddag()
+{
+    gaddag_nodes.clear();
+    gaddag_nodes.shrink_to_fit();
+    gaddag = nullptr;
     return;
 }
 
 void
 destroy_dictionary()
 {
-    delete_trie(dictionary);
+    if (dictionary_map != nullptr) {
+        munmap(dictionary_map, dictionary_map_size);
+        dictionary_map = nullptr;
+        dictionary_map_size = 0;
+    }
+    dictionary_nodes.clear();
+    dictionary_nodes.shrink_to_fit();
+    dictionary = nullptr;
+    return;
+}
+
+// Source of the loaded dictionary
+Dictionary_source dictionary_source;
+
+// Loads the dictionary like make_dictionary(), and its GADDAG if
+// `with_gaddag` is true, unless they are already loaded from the same
+// unchanged file for the same board size. Games played one after the
+// other share the same dictionary.
+void
+load_dictionary(string filename, bool minimize, bool with_gaddag)
+{
+    struct stat file_stat;
+    Dictionary_source source = {filename, 0, 0, BOARD_SIZE, minimize};
+
+    if (stat(filename.c_str(), &file_stat) == 0) {
+        source.mtime = file_stat.st_mtime;
+        source.size = file_stat.st_size;
+    }
+
+    if (dictionary == nullptr
+        || source.filename != dictionary_source.filename
+        || source.mtime != dictionary_source.mtime
+        || source.size != dictionary_source.size
+        || source.board_size != dictionary_source.board_size
+        || source.minimize != dictionary_source.minimize) {
+        destroy_gaddag();
+        destroy_dictionary();
+        make_dictionary(filename, minimize);
+        dictionary_source = source;
+    }
+    if (with_gaddag && gaddag == nullptr) make_gaddag();
     return;
 }
 
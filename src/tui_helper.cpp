@@ -153,7 +153,7 @@ draw_board_delimiter(WINDOW *win, int coordy)
 // Draw board letters at given line
 void
 draw_board_line(WINDOW *win,
-                vector <vector <Letter>> &board,
+                Board &board,
                 int y,
                 int coordy,
                 int sel_y, int sel_x) // Current selected cell
@@ -169,14 +169,14 @@ draw_board_line(WINDOW *win,
         coordx = (x * 4) + 3;
 
         wattron(win, A_BOLD);
-        layer = board.at(y).at(x).layer;
+        layer = board.at(x, y).layer;
         if (layer < 5) wattron(win, COLOR_PAIR(ALETTER_COLOR)); // if cell is active, draw it with color
         if (y == sel_y && x == sel_x) { // if the cell being precessed is currently selected
             wattron(win, A_REVERSE);
-            mvwprintw(win, coordy, coordx + 1, "<%c>", board.at(y).at(x).letter);
+            mvwprintw(win, coordy, coordx + 1, "<%c>", board.at(x, y).letter);
             wattroff(win, A_REVERSE);
         } else
-            mvwprintw(win, coordy, coordx + 1, " %c ", board.at(y).at(x).letter);
+            mvwprintw(win, coordy, coordx + 1, " %c ", board.at(x, y).letter);
         if (layer < 5) wattroff(win, COLOR_PAIR(ALETTER_COLOR));
         wattroff(win, A_BOLD);
 
@@ -205,7 +205,7 @@ draw_board_bottom_border(WINDOW *win, int coordy)
 // Main function for updating game board on window
 void
 update_board_window(WINDOW *brd_win,
-                    vector <vector <Letter>> &board,
+                    Board &board,
                     int sel_y, int sel_x) // Current selected cell
 {
     int coordy;
@@ -236,9 +236,16 @@ move_board_cursor(int y_dir, int x_dir)
     return;
 }
 
+// Number of suggestions that fit in the suggestions window
+int
+suggestions_window_lines()
+{
+    return getmaxy(suggestions_window) - 4;
+}
+
 // Main screen update function. Just call it with parameters
 void
-update_screen(vector <vector <Letter>> &board,
+update_screen(Board &board,
               vector <Player> players,
               vector <string> suggestions,
               unsigned int player_index)